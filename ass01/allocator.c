@@ -11,156 +11,2101 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef VLAD_THREADS
+    #include <pthread.h>
+#endif
+
+#define HEADER_SIZE    sizeof(struct free_list_header)
+
+// With VLAD_HEADERLESS, allocated blocks have no header: every block's magic
+// and size are kept in a side map instead, and objects start right at the
+// start of their block. Free blocks still hold their list links.
+#ifdef VLAD_HEADERLESS
+    #define OBJECT_OFFSET 0
+    #define MIN_ALLOC (1 << 4) // Room for a free block's header
+    #define MIN_ORDER 4        // log2(MIN_ALLOC)
+#else
+    #define OBJECT_OFFSET HEADER_SIZE
+    #define MIN_ALLOC (1 << 5) // Double the header size
+    #define MIN_ORDER 5        // log2(MIN_ALLOC)
+#endif
+#define MIN_INIT_ALLOC (1 << 9)
+#define MAX_ARENA_SIZE (1u << 31) // memory[] indices must fit in a vlink_t
+#define MAGIC_FREE     0xDEADBEEF
+#define MAGIC_ALLOC    0xBEEFDEAD
+#define MAGIC_SLAB     0x51ABDEAD // Allocated, and carved into small objects
+#define MAGIC_ALIGNED  0xA11DDEAD // Marks an object part way into its block
+
+#define NUM_ORDERS     32 // One free list for each power of two block size
+
+#define CACHE_MAX_ORDER    10 // Largest block size kept in thread caches
+#define CACHE_BATCH_BYTES  (1 << 12) // Bytes moved per cache refill or flush
+
+#define SLAB_PAGE_SIZE     (1 << 12) // Size of the block each slab occupies
+#define SLAB_MIN_CHUNK     (1 << 16) // Arenas with smaller chunks don't use slabs
+#define SLAB_FIRST_SLOT    64        // Offset of the first object in a slab
+#define SLAB_MAX_SIZE      256       // Largest request served from a slab
+#define SLAB_MAP_WORDS     8         // Enough for (SLAB_PAGE_SIZE - SLAB_FIRST_SLOT) / 16 bits
+#define NUM_SLAB_CLASSES   8
+
+// Requests small enough to be cached per thread fall into one of these
+// classes: first the slab object sizes, then the buddy block orders from
+// MIN_ORDER up to CACHE_MAX_ORDER
+#define NUM_CLASSES        (NUM_SLAB_CLASSES + CACHE_MAX_ORDER - MIN_ORDER + 1)
+
+typedef unsigned char byte;
+typedef u_int32_t vlink_t;
+typedef u_int32_t vsize_t;
+typedef u_int32_t vaddr_t;
+
+typedef struct free_list_header {
+    u_int32_t magic; // ought to contain MAGIC_FREE
+    vsize_t size;    // # bytes in this block (including header)
+    vlink_t next;    // memory[] index of next free block of the same size
+    vlink_t prev;    // memory[] index of previous free block of the same size
+} free_header_t;
+
+// A slab is a buddy block of SLAB_PAGE_SIZE bytes, aligned to its size, that
+// is cut into equal slots for objects of one small size. Objects carry no
+// header of their own: the slab they are in is found by rounding their
+// address down, and a bitmap in the slab says which slots are free.
+// The first four fields line up with free_header_t, so slabs walk like any
+// other block, and slabs with free slots are listed by next and prev.
+
+typedef struct slab_header {
+    u_int32_t magic;     // ought to contain MAGIC_SLAB
+    vsize_t size;        // SLAB_PAGE_SIZE
+    vlink_t next;        // memory[] index of next slab of this class with free slots
+    vlink_t prev;        // memory[] index of previous slab of this class with free slots
+    u_int16_t class;     // index into slab_sizes[]
+    u_int16_t num_free;  // # free slots
+    u_int32_t free_map[SLAB_MAP_WORDS]; // bit i set iff slot i is free
+} slab_header_t;
+
+#define SLAB_SLOTS(size) ((SLAB_PAGE_SIZE - SLAB_FIRST_SLOT) / (size))
+
+static const u_int16_t slab_sizes[NUM_SLAB_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256
+};
+static const u_int16_t slab_slots[NUM_SLAB_CLASSES] = {
+    SLAB_SLOTS(16), SLAB_SLOTS(32), SLAB_SLOTS(48), SLAB_SLOTS(64),
+    SLAB_SLOTS(96), SLAB_SLOTS(128), SLAB_SLOTS(192), SLAB_SLOTS(256)
+};
+// Slab class for a request of n bytes, indexed by ceil(n / 16)
+static const byte slab_class_of[SLAB_MAX_SIZE / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+};
+
+// An arena reserves memory_size bytes of address space up front, but only
+// maps in chunk_size bytes at a time, as needed. Each chunk is aligned to its
+// size, so every block's buddy is still found by XORing its index with its
+// size, and no block is ever bigger than a chunk. Chunks that become wholly
+// free are given back to the OS, except for one kept spare.
+//
+// Free blocks are kept in one circular list per order (log2 of the block
+// size), so finding a block of a given size never has to look at blocks of
+// any other size. Bit k of free_orders is set iff free_lists[k] is non-empty.
+// Slabs with free slots are likewise kept in one list per slab class.
+//
+// With VLAD_THREADS, everything except the cache key is only touched with
+// `lock` held, bar reads of slab_map (see get_object_class()). Small blocks are handed out from per-thread caches
+// (magazines) so that most calls never take the lock at all.
+
+struct vlad_arena {
+    byte *memory;        // pointer to start of allocator memory
+    vsize_t memory_size; // number of bytes reserved for memory[]
+    vsize_t chunk_size;  // number of bytes mapped in at a time
+
+    u_int32_t num_chunks;     // memory_size / chunk_size
+    u_int32_t *chunk_map;     // bit i set iff chunk i is mapped in
+    u_int32_t chunk_map_word; // chunk_map when there are at most 32 chunks
+
+    vaddr_t free_lists[NUM_ORDERS]; // memory[] index of first block of each order
+    u_int32_t free_orders;
+    u_int32_t free_counts[NUM_ORDERS]; // # blocks on each free list
+    u_int32_t mapped_chunks;           // # bits set in chunk_map
+
+    bool slabs; // whether requests up to SLAB_MAX_SIZE are served from slabs
+    vaddr_t slab_lists[NUM_SLAB_CLASSES]; // memory[] index of first slab with free slots
+    u_int32_t slab_classes; // bit c set iff slab_lists[c] is non-empty
+    size_t slab_free_bytes; // bytes in free slots of all slabs
+    byte *slab_map; // with slabs, one byte per SLAB_PAGE_SIZE of memory[]: 1 iff a slab is there
+
+    // Running totals since the arena was created
+    uint64_t requested; // bytes asked for by each allocation
+    uint64_t granted;   // bytes of heap given to each allocation
+    uint64_t splits;    // blocks split in two
+    uint64_t coalesces; // blocks merged with their buddy
+
+#ifdef VLAD_HEADERLESS
+    // One byte for every MIN_ALLOC bytes of memory[]. The byte for the start
+    // of a block holds its order in the low 5 bits and its state above
+    // them. Bytes for the rest of a block are 0.
+    byte *block_map;
+#endif
+
+#ifdef VLAD_DEBUG
+    void **quarantine;          // ring of freed objects not given back yet
+    u_int32_t quarantine_size;  // # slots in the ring
+    u_int32_t quarantine_count; // # objects in the ring
+    u_int32_t quarantine_next;  // slot the next object freed goes in
+#endif
+
+#ifdef VLAD_THREADS
+    pthread_mutex_t lock;
+    pthread_key_t cache_key; // thread_cache_t * of the calling thread
+#endif
+};
+
+#ifdef VLAD_THREADS
+// Cached objects are linked through their first word
+typedef struct thread_cache {
+    vlad_arena_t *arena;
+    vlink_t head[NUM_CLASSES];    // memory[] index of first cached object
+    u_int32_t count[NUM_CLASSES]; // # objects in each magazine
+    uint64_t requested;           // not yet added to the arena's totals
+    uint64_t granted;
+} thread_cache_t;
+
+    #define heap_lock(arena)             pthread_mutex_lock(&(arena)->lock)
+    #define heap_unlock_unchecked(arena) pthread_mutex_unlock(&(arena)->lock)
+#else
+    #define heap_lock(arena)
+    #define heap_unlock_unchecked(arena)
+#endif
+
+// With VLAD_DEBUG, the whole heap is checked every time the lock is released
+// (or would be, without VLAD_THREADS). That is slow, but catches corruption
+// right after the call that caused it.
+#ifdef VLAD_DEBUG
+    #define heap_unlock(arena) \
+        do { \
+            if (heap_check(arena, false) >= 0) \
+                corrupted(); \
+            heap_unlock_unchecked(arena); \
+        } while (0)
+#else
+    #define heap_unlock(arena) heap_unlock_unchecked(arena)
+#endif
+
+// Global data
+
+static vlad_arena_t default_arena; // the arena used by vlad_init() and friends
+static const vlad_hooks_t *hooks;  // called on every vlad_malloc() and friends
+
+static long heap_check(vlad_arena_t *arena, bool print);
+
+static inline u_int32_t get_block_size(u_int32_t n)
+{
+    if (n <= MIN_ALLOC)
+        return MIN_ALLOC;
+
+    --n;
+    n |= n >> 1;
+    n |= n >> 2;
+    n |= n >> 4;
+    n |= n >> 8;
+    n |= n >> 16;
+    ++n;
+
+    return n;
+}
+
+// Precondition: size is a power of two
+static inline u_int32_t get_order(vsize_t size)
+{
+    return __builtin_ctz(size);
+}
+
+static inline free_header_t *indexToNode(vlad_arena_t *arena, vlink_t index)
+{
+    return (free_header_t *)&arena->memory[index];
+}
+
+static inline vlink_t nodeToIndex(vlad_arena_t *arena, free_header_t *node)
+{
+    return (byte *)node - arena->memory;
+}
+
+static void corrupted(void)
+{
+    fprintf(stderr, "Memory corruption");
+    abort();
+}
+
+#ifdef VLAD_HEADERLESS
+
+#define BLOCK_MAP_ORDER 0x1F
+#define BLOCK_MAP_STATE 5 // shift of the state above the order
+
+// States of the blocks in block_map; 0 means no block starts there
+static const u_int32_t block_magics[] = {
+    0, MAGIC_FREE, MAGIC_ALLOC, MAGIC_SLAB
+};
+
+static inline byte *block_map_entry(vlad_arena_t *arena, free_header_t *node)
+{
+    return &arena->block_map[nodeToIndex(arena, node) / MIN_ALLOC];
+}
+
+static inline byte block_state(u_int32_t magic)
+{
+    switch (magic) {
+    case MAGIC_FREE:   return 1;
+    case MAGIC_ALLOC:  return 2;
+    default:           return 3;
+    }
+}
+
+#endif
+
+// Magic of the block starting at node, or (with VLAD_HEADERLESS) 0 if no
+// block starts there
+static inline u_int32_t block_magic(vlad_arena_t *arena, free_header_t *node)
+{
+#ifdef VLAD_HEADERLESS
+    return block_magics[*block_map_entry(arena, node) >> BLOCK_MAP_STATE];
+#else
+    (void)arena;
+    return node->magic;
+#endif
+}
+
+// Size of the block starting at node
+static inline vsize_t block_size(vlad_arena_t *arena, free_header_t *node)
+{
+#ifdef VLAD_HEADERLESS
+    return 1u << (*block_map_entry(arena, node) & BLOCK_MAP_ORDER);
+#else
+    (void)arena;
+    return node->size;
+#endif
+}
+
+static inline void set_block(vlad_arena_t *arena, free_header_t *node, u_int32_t magic,
+                             vsize_t size)
+{
+#ifdef VLAD_HEADERLESS
+    *block_map_entry(arena, node) = block_state(magic) << BLOCK_MAP_STATE | get_order(size);
+#else
+    (void)arena;
+    node->magic = magic;
+    node->size = size;
+#endif
+}
+
+static inline void set_block_magic(vlad_arena_t *arena, free_header_t *node, u_int32_t magic)
+{
+#ifdef VLAD_HEADERLESS
+    byte *entry = block_map_entry(arena, node);
+    *entry = block_state(magic) << BLOCK_MAP_STATE | (*entry & BLOCK_MAP_ORDER);
+#else
+    (void)arena;
+    node->magic = magic;
+#endif
+}
+
+// Forgets a block that has just been merged into the one below it
+// (A header left as it was would sit inside the bigger block, where a stale
+//  MAGIC_SLAB could pass for a real one at the slab_of() of an object.)
+static inline void clear_block(vlad_arena_t *arena, free_header_t *node)
+{
+#ifdef VLAD_HEADERLESS
+    *block_map_entry(arena, node) = 0;
+#else
+    (void)arena;
+    node->magic = 0;
+#endif
+}
+
+// Forgets every block in a chunk, and any slabs among them
+static inline void clear_chunk_blocks(vlad_arena_t *arena, u_int32_t chunk)
+{
+#ifdef VLAD_HEADERLESS
+    memset(&arena->block_map[(size_t)chunk * arena->chunk_size / MIN_ALLOC], 0,
+        arena->chunk_size / MIN_ALLOC);
+#endif
+    if (arena->slabs)
+        memset(&arena->slab_map[(size_t)chunk * arena->chunk_size / SLAB_PAGE_SIZE], 0,
+            arena->chunk_size / SLAB_PAGE_SIZE);
+}
+
+static inline free_header_t *objectToNode(void *object)
+{
+    return (free_header_t *)((byte *)object - OBJECT_OFFSET);
+}
+
+static inline void *nodeToObject(free_header_t *node)
+{
+    return (byte *)node + OBJECT_OFFSET;
+}
+
+// An object from arena_memalign() may start part way into its block, rather
+// than at nodeToObject(). If so, a marker with MAGIC_ALIGNED and the
+// object's offset in the block is put both just before the object and where
+// the object would normally have started.
+
+// Block of an allocated object
+static inline free_header_t *object_block(vlad_arena_t *arena, void *object)
+{
+#ifdef VLAD_HEADERLESS
+    // Whatever is just before an object at the start of its block belongs
+    // to another block, or may not even be mapped
+    if (*block_map_entry(arena, (free_header_t *)object))
+        return (free_header_t *)object;
+#else
+    (void)arena;
+#endif
+
+    free_header_t *marker = (free_header_t *)object - 1;
+    if (marker->magic == MAGIC_ALIGNED)
+        return (free_header_t *)((byte *)object - marker->size);
+    return objectToNode(object);
+}
+
+// Object of an allocated block
+// (Only for blocks whose objects can't start with MAGIC_ALIGNED themselves,
+//  which is true of every object in debug builds.)
+static inline void *block_object(free_header_t *node)
+{
+    free_header_t *marker = nodeToObject(node);
+    if (marker->magic == MAGIC_ALIGNED)
+        return (byte *)node + marker->size;
+    return marker;
+}
+
+// Puts a block at the head of the circular list lists[k], where bit k of
+// *nonEmpty says whether that list has anything on it
+static void list_push(vlad_arena_t *arena, vaddr_t *lists, u_int32_t *nonEmpty,
+                      u_int32_t k, free_header_t *node)
+{
+    vlink_t index = nodeToIndex(arena, node);
+
+    if (*nonEmpty & (1u << k)) {
+        free_header_t *head = indexToNode(arena, lists[k]);
+        node->next = lists[k];
+        node->prev = head->prev;
+        indexToNode(arena, head->prev)->next = index;
+        head->prev = index;
+    } else {
+        node->next = index;
+        node->prev = index;
+        *nonEmpty |= 1u << k;
+    }
+    lists[k] = index;
+}
+
+// Unlinks a block from the circular list lists[k]
+static void list_remove(vlad_arena_t *arena, vaddr_t *lists, u_int32_t *nonEmpty,
+                        u_int32_t k, free_header_t *node)
+{
+    vlink_t index = nodeToIndex(arena, node);
+
+    if (node->next == index) {
+        *nonEmpty &= ~(1u << k);
+    } else {
+        indexToNode(arena, node->next)->prev = node->prev;
+        indexToNode(arena, node->prev)->next = node->next;
+        if (lists[k] == index)
+            lists[k] = node->next;
+    }
+}
+
+// Marks the block as a free one of the given size and puts it at the head
+// of the list for its order
+static inline void free_list_push(vlad_arena_t *arena, free_header_t *node, vsize_t size)
+{
+    set_block(arena, node, MAGIC_FREE, size);
+    ++arena->free_counts[get_order(size)];
+    list_push(arena, arena->free_lists, &arena->free_orders, get_order(size), node);
+}
+
+// Unlinks a free block from the list for its order. Its magic is untouched.
+static inline void free_list_remove(vlad_arena_t *arena, free_header_t *node)
+{
+    u_int32_t order = get_order(block_size(arena, node));
+    --arena->free_counts[order];
+    list_remove(arena, arena->free_lists, &arena->free_orders, order, node);
+}
+
+static inline bool chunk_is_mapped(vlad_arena_t *arena, u_int32_t chunk)
+{
+    return arena->chunk_map[chunk / 32] & (1u << chunk % 32);
+}
+
+// Makes a chunk of the reserved address space usable. Its pages are only
+// actually allocated by the OS once they are touched.
+
+static bool chunk_map_in(vlad_arena_t *arena, u_int32_t chunk)
+{
+    if (mprotect(indexToNode(arena, chunk * arena->chunk_size), arena->chunk_size,
+            PROT_READ | PROT_WRITE))
+        return false;
+
+    arena->chunk_map[chunk / 32] |= 1u << chunk % 32;
+    ++arena->mapped_chunks;
+    return true;
+}
+
+// Gives a chunk's pages back to the OS, leaving its address space reserved
+// but inaccessible
+
+static bool chunk_map_out(vlad_arena_t *arena, u_int32_t chunk)
+{
+    if (mmap(indexToNode(arena, chunk * arena->chunk_size), arena->chunk_size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED)
+        return false;
+
+    arena->chunk_map[chunk / 32] &= ~(1u << chunk % 32);
+    --arena->mapped_chunks;
+    return true;
+}
+
+// Maps in the lowest unmapped chunk as a single free block.
+// Returns false if every chunk is already mapped in.
+
+static bool heap_grow(vlad_arena_t *arena)
+{
+    for (u_int32_t word = 0; word * 32 < arena->num_chunks; ++word) {
+        u_int32_t unmapped = ~arena->chunk_map[word];
+        if (!unmapped)
+            continue;
+
+        u_int32_t chunk = word * 32 + __builtin_ctz(unmapped);
+        if (chunk >= arena->num_chunks || !chunk_map_in(arena, chunk))
+            return false;
+
+        free_list_push(arena, indexToNode(arena, chunk * arena->chunk_size), arena->chunk_size);
+        return true;
+    }
+
+    return false;
+}
+
+// Reports a problem found at the given offset of memory[] on stderr, and
+// returns the offset
+static long heap_report(long offset, const char *problem)
+{
+    fprintf(stderr, "vlad: heap corrupted at offset %ld: %s\n", offset, problem);
+    return offset;
+}
+
+#define heap_expect(condition, offset, problem) \
+    do { \
+        if (!(condition)) \
+            return heap_report(offset, problem); \
+    } while (0)
+
+// Checks every invariant of the heap: blocks tile each mapped chunk in
+// address order, each aligned to its size, no two free buddies are left
+// unmerged, and the free lists and running counts agree with what is
+// actually there. If `print` is set, free blocks are listed on stdout in
+// address order as they are found.
+// Returns -1 if all is well. Otherwise, reports the first problem found and
+// returns the offset of the block it is in, or memory_size if it is not in
+// any one block.
+// Precondition: the arena's lock is held
+
+static long heap_check(vlad_arena_t *arena, bool print)
+{
+    // Walk every block in address order, so free blocks are listed the same
+    // way regardless of which per-order list they are on
+    size_t n = 0;
+    u_int32_t mapped = 0;
+    u_int32_t counts[NUM_ORDERS] = {0};
+    size_t slabFree = 0;
+    for (u_int32_t chunk = 0; chunk < arena->num_chunks; ++chunk) {
+        if (!chunk_is_mapped(arena, chunk))
+            continue;
+        ++mapped;
+
+        vaddr_t offset = chunk * arena->chunk_size;
+        vaddr_t end = offset + arena->chunk_size;
+        while (offset < end) {
+            free_header_t *node = indexToNode(arena, offset);
+            u_int32_t magic = block_magic(arena, node);
+            vsize_t size = block_size(arena, node);
+            heap_expect(size >= MIN_ALLOC && size == get_block_size(size) && size <= end - offset,
+                offset, "bad block size");
+            heap_expect((offset & (size - 1)) == 0, offset, "misaligned block");
+
+            if (magic == MAGIC_FREE) {
+                ++n;
+                if (print)
+                    printf("%zu:\t%p:%u\n", n, (void*)node, size);
+                ++counts[get_order(size)];
+
+                heap_expect(arena->free_orders & (1u << get_order(size)), offset,
+                    "free block of an empty order");
+                heap_expect(node->next < arena->memory_size && node->prev < arena->memory_size &&
+                    indexToNode(arena, node->next)->prev == offset &&
+                    indexToNode(arena, node->prev)->next == offset, offset, "bad free list links");
+                heap_expect(block_size(arena, indexToNode(arena, node->next)) == size, offset,
+                    "next free block is of another size");
+
+                if (size < arena->chunk_size) {
+                    free_header_t *buddyNode = indexToNode(arena, offset ^ size);
+                    heap_expect(block_magic(arena, buddyNode) != MAGIC_FREE ||
+                        block_size(arena, buddyNode) != size, offset, "unmerged free buddies");
+                }
+            } else if (magic == MAGIC_SLAB) {
+                slab_header_t *slab = (slab_header_t *)node;
+                heap_expect(size == SLAB_PAGE_SIZE && slab->class < NUM_SLAB_CLASSES &&
+                    slab->num_free <= slab_slots[slab->class], offset, "bad slab header");
+                slabFree += slab->num_free * slab_sizes[slab->class];
+            } else {
+                heap_expect(magic == MAGIC_ALLOC, offset, "bad magic");
+            }
+
+            offset += size;
+        }
+    }
+
+    // Every block on the free lists must have been seen by the walk above
+    long whole = arena->memory_size;
+    size_t listed = 0;
+    for (u_int32_t order = 0; order < NUM_ORDERS; ++order) {
+        if (!(arena->free_orders & (1u << order)))
+            continue;
+
+        vlink_t index = arena->free_lists[order];
+        do {
+            heap_expect(listed < n && index < arena->memory_size &&
+                block_magic(arena, indexToNode(arena, index)) == MAGIC_FREE,
+                whole, "free lists hold a block that is not free");
+            ++listed;
+            index = indexToNode(arena, index)->next;
+        } while (index != arena->free_lists[order]);
+    }
+    heap_expect(listed == n, whole, "free block missing from the free lists");
+
+    // The running counts must agree with the walk
+    heap_expect(mapped == arena->mapped_chunks, whole, "wrong count of mapped chunks");
+    heap_expect(slabFree == arena->slab_free_bytes, whole, "wrong count of free slab bytes");
+    for (u_int32_t order = 0; order < NUM_ORDERS; ++order)
+        heap_expect(counts[order] == arena->free_counts[order], whole,
+            "wrong count of free blocks");
+
+    return -1;
+}
+
+
+// Takes a block of exactly `size` bytes off the free lists, splitting a
+// larger one if needed. Returns NULL if no free block is big enough and the
+// arena cannot grow.
+
+static free_header_t *heap_alloc(vlad_arena_t *arena, vsize_t size)
+{
+    // Smallest non-empty order that is big enough
+    u_int32_t available = arena->free_orders & ~((1u << get_order(size)) - 1);
+    if (!available) {
+        if (!heap_grow(arena))
+            return NULL;
+        available = arena->free_orders & ~((1u << get_order(size)) - 1);
+    }
+
+    free_header_t *node = indexToNode(arena, arena->free_lists[__builtin_ctz(available)]);
+    if (block_magic(arena, node) != MAGIC_FREE)
+        corrupted();
+    free_list_remove(arena, node);
+
+    for (vsize_t nodeSize = block_size(arena, node); nodeSize > size; ) {
+        nodeSize /= 2;
+        ++arena->splits;
+        free_list_push(arena, (free_header_t *)((byte *)node + nodeSize), nodeSize);
+    }
+
+    set_block(arena, node, MAGIC_ALLOC, size);
+    return node;
+}
+
+// Puts an allocated block back on the free lists, merging it with its buddy
+// for as long as the buddy is free as well
+
+static void heap_free(vlad_arena_t *arena, free_header_t *node)
+{
+    vsize_t size = block_size(arena, node);
+    while (size < arena->chunk_size) {
+        free_header_t *buddyNode = indexToNode(arena, nodeToIndex(arena, node) ^ size);
+        u_int32_t buddyMagic = block_magic(arena, buddyNode);
+        if (block_size(arena, buddyNode) != size || buddyMagic == MAGIC_ALLOC ||
+                buddyMagic == MAGIC_SLAB)
+            break;
+        else if (buddyMagic != MAGIC_FREE)
+            corrupted();
+
+        free_list_remove(arena, buddyNode);
+        if (buddyNode < node) {
+            clear_block(arena, node);
+            node = buddyNode;
+        } else {
+            clear_block(arena, buddyNode);
+        }
+        size *= 2;
+        ++arena->coalesces;
+    }
+
+    // A wholly free chunk goes back to the OS, unless it is the only one.
+    // Keeping one spare stops a heap that hovers around a chunk boundary
+    // from mapping and unmapping on every call.
+    // (Cleared first, as there's no header to clear once it's mapped out)
+    u_int32_t order = get_order(size);
+    if (size == arena->chunk_size && (arena->free_orders & (1u << order))) {
+        clear_block(arena, node);
+        if (chunk_map_out(arena, nodeToIndex(arena, node) / arena->chunk_size))
+            return;
+    }
+
+    free_list_push(arena, node, size);
+}
+
+static inline slab_header_t *slab_of(void *object)
+{
+    return (slab_header_t *)((uintptr_t)object & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+// Whether the page an object is on is a slab. Unlike the block header at
+// slab_of(), which may belong to some other block that other threads are
+// busy with, a page's entry in slab_map only changes when a slab is made or
+// unmade there, which can't happen while an object of ours is on it. It is
+// written with the lock held and read without it, so both are atomic.
+static inline bool in_slab(vlad_arena_t *arena, void *object)
+{
+    return __atomic_load_n(&arena->slab_map[((byte *)object - arena->memory) / SLAB_PAGE_SIZE],
+                           __ATOMIC_RELAXED);
+}
+
+static inline void set_in_slab(vlad_arena_t *arena, slab_header_t *slab, byte isSlab)
+{
+    __atomic_store_n(&arena->slab_map[((byte *)slab - arena->memory) / SLAB_PAGE_SIZE],
+                     isSlab, __ATOMIC_RELAXED);
+}
+
+// Takes a free slot from a slab of the given class, starting a new slab if
+// none have any free slots. Returns NULL if there is no room for a new slab.
+
+static void *slab_alloc(vlad_arena_t *arena, u_int32_t class)
+{
+    slab_header_t *slab;
+    if (arena->slab_classes & (1u << class)) {
+        slab = (slab_header_t *)indexToNode(arena, arena->slab_lists[class]);
+    } else {
+        free_header_t *node = heap_alloc(arena, SLAB_PAGE_SIZE);
+        if (!node)
+            return NULL;
+
+        slab = (slab_header_t *)node;
+        set_block_magic(arena, node, MAGIC_SLAB);
+        set_in_slab(arena, slab, 1);
+        slab->class = class;
+        slab->num_free = slab_slots[class];
+        for (u_int32_t word = 0; word < SLAB_MAP_WORDS; ++word) {
+            u_int32_t slots = word * 32 >= slab_slots[class] ? 0 : slab_slots[class] - word * 32;
+            slab->free_map[word] = slots >= 32 ? ~0u : (1u << slots) - 1;
+        }
+        arena->slab_free_bytes += slab_slots[class] * slab_sizes[class];
+        list_push(arena, arena->slab_lists, &arena->slab_classes, class, node);
+    }
+
+    u_int32_t word = 0;
+    while (!slab->free_map[word])
+        ++word;
+    u_int32_t slot = word * 32 + __builtin_ctz(slab->free_map[word]);
+    slab->free_map[word] &= slab->free_map[word] - 1;
+    arena->slab_free_bytes -= slab_sizes[class];
+
+    if (!--slab->num_free)
+        list_remove(arena, arena->slab_lists, &arena->slab_classes, class, (free_header_t *)slab);
+
+    return (byte *)slab + SLAB_FIRST_SLOT + slot * slab_sizes[class];
+}
+
+// Gives a slot back to its slab. A slab left with nothing in it goes back to
+// the heap, unless it is the only one of its class with free slots.
+
+static void slab_free(vlad_arena_t *arena, void *object)
+{
+    slab_header_t *slab = slab_of(object);
+    u_int32_t class = slab->class;
+    u_int32_t slot = ((byte *)object - (byte *)slab - SLAB_FIRST_SLOT) / slab_sizes[class];
+
+    if (slab->free_map[slot / 32] & (1u << slot % 32)) {
+        fprintf(stderr, "Attempt to free non-allocated memory");
+        abort();
+    }
+    slab->free_map[slot / 32] |= 1u << slot % 32;
+    arena->slab_free_bytes += slab_sizes[class];
+
+    if (!slab->num_free++) {
+        list_push(arena, arena->slab_lists, &arena->slab_classes, class, (free_header_t *)slab);
+    } else if (slab->num_free == slab_slots[class] &&
+            slab->next != nodeToIndex(arena, (free_header_t *)slab)) {
+        list_remove(arena, arena->slab_lists, &arena->slab_classes, class, (free_header_t *)slab);
+        arena->slab_free_bytes -= slab_slots[class] * slab_sizes[class];
+        set_in_slab(arena, slab, 0);
+        heap_free(arena, (free_header_t *)slab);
+    }
+}
+
+// Number of bytes each object of a class takes up
+static inline u_int32_t class_size(u_int32_t class)
+{
+    if (class < NUM_SLAB_CLASSES)
+        return slab_sizes[class];
+    return 1u << (class - NUM_SLAB_CLASSES + MIN_ORDER);
+}
+
+// Class of an n-byte request, or NUM_CLASSES if it is too big to have one
+static inline u_int32_t get_class(vlad_arena_t *arena, u_int32_t n)
+{
+    if (n <= SLAB_MAX_SIZE && arena->slabs)
+        return slab_class_of[(n + 15) / 16];
+
+    u_int32_t order = get_order(get_block_size(OBJECT_OFFSET + n));
+    return order <= CACHE_MAX_ORDER ? NUM_SLAB_CLASSES + order - MIN_ORDER : NUM_CLASSES;
+}
+
+// Class of an allocated object, or NUM_CLASSES for a big block. Aborts if
+// object does not look like something handed out by the arena.
+
+static u_int32_t get_object_class(vlad_arena_t *arena, void *object)
+{
+    if ((byte *)object < arena->memory + OBJECT_OFFSET ||
+            (byte *)object >= arena->memory + arena->memory_size ||
+            ((byte *)object - arena->memory - OBJECT_OFFSET) % 16 ||
+            !chunk_is_mapped(arena, ((byte *)object - arena->memory) / arena->chunk_size)) {
+        fprintf(stderr, "Attempt to free non-allocated memory");
+        abort();
+    }
+
+    // (Not block_magic(slab_of(object)), which may be the header of another
+    //  block, or whatever an earlier object left there; see in_slab().)
+    if (arena->slabs && in_slab(arena, object)) {
+        slab_header_t *slab = slab_of(object);
+        u_int32_t offset = (byte *)object - (byte *)slab;
+        if (offset < SLAB_FIRST_SLOT || (offset - SLAB_FIRST_SLOT) % slab_sizes[slab->class] ||
+                (offset - SLAB_FIRST_SLOT) / slab_sizes[slab->class] >= slab_slots[slab->class]) {
+            fprintf(stderr, "Attempt to free non-allocated memory");
+            abort();
+        }
+        return slab->class;
+    }
+
+    free_header_t *node = object_block(arena, object);
+    vaddr_t offset = (byte *)object - (byte *)node;
+    if ((byte *)node < arena->memory || ((byte *)node - arena->memory) % MIN_ALLOC ||
+            offset > ((byte *)object - arena->memory) % arena->chunk_size ||
+            block_magic(arena, node) != MAGIC_ALLOC) {
+        fprintf(stderr, "Attempt to free non-allocated memory");
+        abort();
+    }
+
+    vsize_t size = block_size(arena, node);
+    if (size != get_block_size(size) || size < MIN_ALLOC || offset >= size)
+        corrupted();
+
+    // Objects part way into their blocks can't be handed out again as is
+    if (offset != OBJECT_OFFSET)
+        return NUM_CLASSES;
+
+    u_int32_t order = get_order(size);
+    return order <= CACHE_MAX_ORDER ? NUM_SLAB_CLASSES + order - MIN_ORDER : NUM_CLASSES;
+}
+
+// Allocates a whole block of `size` bytes, returning a pointer just past its
+// header (if it has one), or NULL
+
+static inline void *block_alloc(vlad_arena_t *arena, vsize_t size)
+{
+    free_header_t *node = heap_alloc(arena, size);
+    return node ? nodeToObject(node) : NULL;
+}
+
+static inline void block_free(vlad_arena_t *arena, void *object)
+{
+    heap_free(arena, object_block(arena, object));
+}
+
+// Tries to resize an allocated block to `size` bytes without moving it: by
+// splitting off free upper halves to shrink it, or by absorbing its upper
+// buddy, for as many times as it takes, to grow it. Returns false, leaving
+// the block untouched, if the buddies it would need are not all free.
+
+static bool block_resize(vlad_arena_t *arena, free_header_t *node, vsize_t size)
+{
+    vsize_t nodeSize = block_size(arena, node);
+    if (nodeSize > size) {
+        set_block(arena, node, MAGIC_ALLOC, size);
+
+        // The upper half's buddy is the block itself, so nothing to merge
+        while (nodeSize > size) {
+            nodeSize /= 2;
+            ++arena->splits;
+            free_list_push(arena, (free_header_t *)((byte *)node + nodeSize), nodeSize);
+        }
+    }
+
+    if (size > arena->chunk_size)
+        return false;
+
+    vlink_t index = nodeToIndex(arena, node);
+    for (vsize_t blockSize = nodeSize; blockSize < size; blockSize *= 2) {
+        free_header_t *buddyNode = indexToNode(arena, index + blockSize);
+        if ((index & blockSize) || block_magic(arena, buddyNode) != MAGIC_FREE ||
+                block_size(arena, buddyNode) != blockSize)
+            return false;
+    }
+
+    for (; nodeSize < size; nodeSize *= 2) {
+        free_header_t *buddyNode = indexToNode(arena, index + nodeSize);
+        free_list_remove(arena, buddyNode);
+        clear_block(arena, buddyNode);
+        ++arena->coalesces;
+    }
+    set_block(arena, node, MAGIC_ALLOC, nodeSize);
+
+    return true;
+}
+
+// Allocates up to `count` blocks of `size` bytes into objects[], by taking
+// as big a block as the heap has (up to what the batch needs), cutting the
+// blocks off its bottom in one pass and freeing what is left over as the
+// biggest aligned blocks that fit. Returns how many were allocated, which is
+// only less than count if the heap runs out.
+
+static u_int32_t block_alloc_batch(vlad_arena_t *arena, vsize_t size, u_int32_t count,
+                                   void **objects)
+{
+    u_int32_t done = 0;
+    while (done < count) {
+        u_int32_t wanted = count - done;
+        vsize_t batchSize = wanted >= arena->chunk_size / size ?
+            arena->chunk_size : get_block_size(wanted * size);
+
+        free_header_t *node;
+        while (!(node = heap_alloc(arena, batchSize)) && batchSize > size)
+            batchSize /= 2;
+        if (!node)
+            break;
+
+        vaddr_t start = nodeToIndex(arena, node);
+        u_int32_t pieces = batchSize / size < wanted ? batchSize / size : wanted;
+        for (u_int32_t i = 0; i < pieces; ++i) {
+            free_header_t *piece = indexToNode(arena, start + i * size);
+            set_block(arena, piece, MAGIC_ALLOC, size);
+            objects[done++] = nodeToObject(piece);
+        }
+
+        // Each leftover block is as big as its offset's alignment allows, so
+        // its lower buddy always overlaps the pieces and cannot be free
+        u_int32_t leftovers = 0;
+        for (vaddr_t offset = pieces * size; offset < batchSize; ++leftovers) {
+            vsize_t leftoverSize = offset & -offset;
+            free_list_push(arena, indexToNode(arena, start + offset), leftoverSize);
+            offset += leftoverSize;
+        }
+        arena->splits += pieces + leftovers - 1;
+    }
+
+    return done;
+}
+
+// Allocates an object of the given class, or returns NULL
+static inline void *class_alloc(vlad_arena_t *arena, u_int32_t class)
+{
+    if (class < NUM_SLAB_CLASSES)
+        return slab_alloc(arena, class);
+    return block_alloc(arena, class_size(class));
+}
+
+static inline void class_free(vlad_arena_t *arena, u_int32_t class, void *object)
+{
+    if (class < NUM_SLAB_CLASSES)
+        slab_free(arena, object);
+    else
+        block_free(arena, object);
+}
+
+// Allocates up to `count` objects of the given class into objects[], and
+// returns how many were allocated
+
+static u_int32_t class_alloc_batch(vlad_arena_t *arena, u_int32_t class, u_int32_t count,
+                                   void **objects)
+{
+    if (class >= NUM_SLAB_CLASSES)
+        return block_alloc_batch(arena, class_size(class), count, objects);
+
+    u_int32_t done = 0;
+    while (done < count && (objects[done] = slab_alloc(arena, class)))
+        ++done;
+    return done;
+}
+
+// Frees a run of block objects sorted by address. Blocks that are buddies of each
+// other are merged on a stack as they come, before touching any free list,
+// so a run that was allocated together goes back as a few big blocks.
+// Aborts if the same block appears twice.
+
+static void block_free_sorted(vlad_arena_t *arena, void **objects, u_int32_t count)
+{
+    free_header_t *pending[NUM_ORDERS];
+    u_int32_t numPending = 0;
+
+    for (u_int32_t i = 0; i <= count; ++i) {
+        free_header_t *node = i < count ? object_block(arena, objects[i]) : NULL;
+        if (node && i && objects[i] == objects[i - 1]) {
+            fprintf(stderr, "Attempt to free non-allocated memory");
+            abort();
+        }
+
+        // Nothing pending can merge with a block that doesn't follow it
+        if (numPending && (!node || numPending == NUM_ORDERS ||
+                (byte *)pending[numPending - 1] + block_size(arena, pending[numPending - 1]) !=
+                    (byte *)node)) {
+            for (u_int32_t j = 0; j < numPending; ++j)
+                heap_free(arena, pending[j]);
+            numPending = 0;
+        }
+        if (!node)
+            break;
+
+        pending[numPending++] = node;
+        while (numPending >= 2) {
+            free_header_t *lower = pending[numPending - 2];
+            free_header_t *upper = pending[numPending - 1];
+            vsize_t size = block_size(arena, lower);
+            if (block_size(arena, upper) != size || size == arena->chunk_size ||
+                    (nodeToIndex(arena, lower) & size))
+                break;
+
+            set_block(arena, lower, MAGIC_ALLOC, size * 2);
+            clear_block(arena, upper);
+            ++arena->coalesces;
+            --numPending;
+        }
+    }
+}
+
+#ifdef VLAD_THREADS
+
+// Parks an allocated object in one of the thread's magazines. Its block
+// stays marked as allocated, so it isn't coalesced; nothing shared is
+// written here, as other threads read block headers (with the lock held)
+// while this thread doesn't hold it.
+
+static inline void cache_push(thread_cache_t *cache, u_int32_t class, void *object)
+{
+    *(vlink_t *)object = cache->head[class];
+    cache->head[class] = (byte *)object - cache->arena->memory;
+    ++cache->count[class];
+}
+
+static inline void *cache_pop(thread_cache_t *cache, u_int32_t class)
+{
+    void *object = &cache->arena->memory[cache->head[class]];
+    cache->head[class] = *(vlink_t *)object;
+    --cache->count[class];
+    return object;
+}
+
+// Adds what the thread has allocated since it last took the lock to the
+// arena's running totals
+// Precondition: the arena's lock is held
+
+static inline void cache_count(thread_cache_t *cache)
+{
+    cache->arena->requested += cache->requested;
+    cache->arena->granted += cache->granted;
+    cache->requested = cache->granted = 0;
+}
+
+// Gives all but `keep` objects in one of a thread's magazines back to the heap
+// Precondition: the arena's lock is held
+
+static void cache_flush(thread_cache_t *cache, u_int32_t class, u_int32_t keep)
+{
+    cache_count(cache);
+    while (cache->count[class] > keep)
+        class_free(cache->arena, class, cache_pop(cache, class));
+}
+
+// Destructor for cache_key: the cache of an exiting thread, and every object
+// in it, goes back to the heap
+
+static void cache_destroy(void *object)
+{
+    thread_cache_t *cache = object;
+    vlad_arena_t *arena = cache->arena;
+
+    heap_lock(arena);
+    for (u_int32_t class = 0; class < NUM_CLASSES; ++class)
+        cache_flush(cache, class, 0);
+    block_free(arena, cache);
+    heap_unlock(arena);
+}
+
+// Returns the calling thread's cache, creating it on first use. The cache
+// itself lives in the heap. Returns NULL if the heap has no room for it.
+
+static thread_cache_t *get_cache(vlad_arena_t *arena)
+{
+#ifdef VLAD_DEBUG
+    // Objects parked in a cache can't be told apart from ones in use, so
+    // debug builds do without
+    return NULL;
+#endif
+
+    thread_cache_t *cache = pthread_getspecific(arena->cache_key);
+    if (cache)
+        return cache;
+
+    heap_lock(arena);
+    cache = block_alloc(arena, get_block_size(OBJECT_OFFSET + sizeof(thread_cache_t)));
+    heap_unlock(arena);
+    if (!cache)
+        return NULL;
+
+    cache->arena = arena;
+    for (u_int32_t class = 0; class < NUM_CLASSES; ++class)
+        cache->count[class] = 0;
+    cache->requested = cache->granted = 0;
+    pthread_setspecific(arena->cache_key, cache);
+
+    return cache;
+}
+
+// Pops an object off the thread's magazine for its class, refilling an empty
+// magazine from the heap with a whole batch of objects under a single lock
+
+static void *cache_alloc(thread_cache_t *cache, u_int32_t class)
+{
+    vlad_arena_t *arena = cache->arena;
+
+    if (!cache->count[class]) {
+        void *objects[CACHE_BATCH_BYTES / 16]; // 16 bytes is the smallest class
+
+        heap_lock(arena);
+        cache_count(cache);
+        u_int32_t count = class_alloc_batch(arena, class,
+            CACHE_BATCH_BYTES / class_size(class), objects);
+        heap_unlock(arena);
+
+        if (!count)
+            return NULL;
+
+        // Lowest addresses go on top, so they are handed out first
+        while (count)
+            cache_push(cache, class, objects[--count]);
+    }
+
+    return cache_pop(cache, class);
+}
+
+// Parks a freed object in the thread's magazine. Once the magazine holds two
+// batches, one batch is returned to the heap (and coalesced there), so a
+// thread alternating between malloc and free does not bounce on the lock.
+// (A cached object still looks allocated, so only the commonest double free,
+//  of the object freed just before, is caught here; debug builds have no
+//  caches, and catch them all.)
+
+static void cache_free(thread_cache_t *cache, u_int32_t class, void *object)
+{
+    vlad_arena_t *arena = cache->arena;
+    u_int32_t batch = CACHE_BATCH_BYTES / class_size(class);
+
+    if (cache->count[class] && (byte *)object - arena->memory == cache->head[class]) {
+        fprintf(stderr, "Attempt to free non-allocated memory");
+        abort();
+    }
+    cache_push(cache, class, object);
+    if (cache->count[class] >= 2 * batch) {
+        heap_lock(arena);
+        cache_flush(cache, class, batch);
+        heap_unlock(arena);
+    }
+}
+
+#endif
+
+// Adds an allocation of n bytes, which took up `granted` bytes of the heap,
+// to the arena's running totals. A thread with a cache keeps them there
+// until it next takes the lock anyway.
+
+static void count_alloc(vlad_arena_t *arena, u_int32_t n, vsize_t granted)
+{
+#ifdef VLAD_THREADS
+    thread_cache_t *cache = pthread_getspecific(arena->cache_key);
+    if (cache) {
+        cache->requested += n;
+        cache->granted += granted;
+        return;
+    }
+#endif
+
+    heap_lock(arena);
+    arena->requested += n;
+    arena->granted += granted;
+    heap_unlock(arena);
+}
+
+// Shrinks the arena back to its first chunk, as a single free block
+
+static void arena_clear(vlad_arena_t *arena)
+{
+    arena->free_orders = 0;
+    arena->slab_classes = 0;
+    arena->slab_free_bytes = 0;
+    memset(arena->free_counts, 0, sizeof(arena->free_counts));
+#ifdef VLAD_DEBUG
+    arena->quarantine_count = arena->quarantine_next = 0;
+#endif
+
+    for (u_int32_t chunk = 1; chunk < arena->num_chunks; ++chunk) {
+        if (chunk_is_mapped(arena, chunk)) {
+            chunk_map_out(arena, chunk);
+            clear_chunk_blocks(arena, chunk);
+        }
+    }
+
+    if (!chunk_is_mapped(arena, 0) && !chunk_map_in(arena, 0)) {
+        fprintf(stderr, "vlad: insufficient memory");
+        abort();
+    }
+    clear_chunk_blocks(arena, 0);
+
+    free_list_push(arena, indexToNode(arena, 0), arena->chunk_size);
+
+#ifdef VLAD_THREADS
+    if (pthread_key_create(&arena->cache_key, cache_destroy)) {
+        fprintf(stderr, "vlad: cannot create thread cache key");
+        abort();
+    }
+#endif
+}
+
+// Reserves address space for max_size bytes, but maps in only the first
+// chunk_size bytes. Both sizes are rounded to something workable.
+
+static void arena_init(vlad_arena_t *arena, u_int32_t chunk_size, u_int32_t max_size)
+{
+    if (chunk_size > MAX_ARENA_SIZE)
+        chunk_size = MAX_ARENA_SIZE;
+    chunk_size = chunk_size < MIN_INIT_ALLOC ? MIN_INIT_ALLOC : get_block_size(chunk_size);
+    if (max_size > MAX_ARENA_SIZE)
+        max_size = MAX_ARENA_SIZE;
+    if (max_size < chunk_size)
+        max_size = chunk_size;
+
+    arena->chunk_size = chunk_size;
+    arena->num_chunks = max_size / chunk_size;
+    arena->slabs = chunk_size >= SLAB_MIN_CHUNK;
+    arena->memory_size = arena->num_chunks * chunk_size;
+    arena->mapped_chunks = 0;
+    arena->requested = arena->granted = 0;
+    arena->splits = arena->coalesces = 0;
+#ifdef VLAD_DEBUG
+    arena->quarantine = NULL;
+    arena->quarantine_size = 0;
+#endif
+
+    // Reserve an extra chunk's worth, so that memory[] can be aligned to the
+    // chunk size, then give back what is left over on either side
+    size_t reserved = (size_t)arena->memory_size + chunk_size;
+    byte *start = mmap(NULL, reserved, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (start == MAP_FAILED) {
+        fprintf(stderr, "vlad_init: insufficient memory");
+        abort();
+    }
+
+    arena->memory = (byte *)(((uintptr_t)start + chunk_size - 1) & ~(uintptr_t)(chunk_size - 1));
+    if (arena->memory > start)
+        munmap(start, arena->memory - start);
+    munmap(arena->memory + arena->memory_size,
+        start + reserved - (arena->memory + arena->memory_size));
+
+    if (arena->num_chunks <= 32) {
+        arena->chunk_map = &arena->chunk_map_word;
+        arena->chunk_map_word = 0;
+    } else {
+        arena->chunk_map = mmap(NULL, (arena->num_chunks + 31) / 32 * sizeof(u_int32_t),
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (arena->chunk_map == MAP_FAILED) {
+            fprintf(stderr, "vlad_init: insufficient memory");
+            abort();
+        }
+    }
+
+    if (arena->slabs) {
+        arena->slab_map = mmap(NULL, arena->memory_size / SLAB_PAGE_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (arena->slab_map == MAP_FAILED) {
+            fprintf(stderr, "vlad_init: insufficient memory");
+            abort();
+        }
+    }
+
+#ifdef VLAD_HEADERLESS
+    // Like memory[], the block map only takes up memory where it is used
+    arena->block_map = mmap(NULL, arena->memory_size / MIN_ALLOC, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena->block_map == MAP_FAILED) {
+        fprintf(stderr, "vlad_init: insufficient memory");
+        abort();
+    }
+#endif
+
+#ifdef VLAD_THREADS
+    pthread_mutex_init(&arena->lock, NULL);
+#endif
+    arena_clear(arena);
+}
+
+static void arena_release(vlad_arena_t *arena)
+{
+#ifdef VLAD_THREADS
+    // Thread caches live in memory[], so they simply vanish with it. Deleting
+    // the key stops their destructors from running later on.
+    pthread_key_delete(arena->cache_key);
+    pthread_mutex_destroy(&arena->lock);
+#endif
+
+    if (arena->chunk_map != &arena->chunk_map_word)
+        munmap(arena->chunk_map, (arena->num_chunks + 31) / 32 * sizeof(u_int32_t));
+    if (arena->slabs)
+        munmap(arena->slab_map, arena->memory_size / SLAB_PAGE_SIZE);
+#ifdef VLAD_HEADERLESS
+    munmap(arena->block_map, arena->memory_size / MIN_ALLOC);
+#endif
+#ifdef VLAD_DEBUG
+    if (arena->quarantine)
+        munmap(arena->quarantine, arena->quarantine_size * sizeof(void *));
+#endif
+    munmap(arena->memory, arena->memory_size);
+    arena->memory = NULL;
+}
+
+// Gets memory for an arena's descriptor straight from the OS, so that vlad
+// can stand in for malloc() itself
+
+static vlad_arena_t *arena_new(void)
+{
+    vlad_arena_t *arena = mmap(NULL, sizeof(vlad_arena_t), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED) {
+        fprintf(stderr, "vlad_arena_create: insufficient memory");
+        abort();
+    }
+    return arena;
+}
+
+// Input: size - number of bytes to make available to the arena
+// Output: arena - a handle for the new arena
+// Precondition: none
+// Postcondition: `size` bytes rounded up to a power of two are available to
+//                vlad_arena_malloc(arena, ...)
+
+vlad_arena_t *vlad_arena_create(u_int32_t size)
+{
+    vlad_arena_t *arena = arena_new();
+
+    arena_init(arena, size, size);
+    return arena;
+}
+
+// Input: chunk_size - number of bytes to add to the arena at a time
+//        max_size - number of bytes the arena may grow to
+// Output: arena - a handle for the new arena
+// Precondition: none
+// Postcondition: chunk_size bytes rounded up to a power of two are available
+//                to vlad_arena_malloc(arena, ...), and more chunks are added
+//                as needed until the arena reaches max_size bytes
+//
+// (No single allocation can be bigger than a chunk. Chunks that become
+//  wholly free are given back to the OS, apart from one kept spare.)
+
+vlad_arena_t *vlad_arena_create_growable(u_int32_t chunk_size, u_int32_t max_size)
+{
+    vlad_arena_t *arena = arena_new();
+
+    // Chunks are mapped in and out whole, so they can't be smaller than a page
+    u_int32_t page_size = sysconf(_SC_PAGESIZE);
+    arena_init(arena, chunk_size < page_size ? page_size : chunk_size, max_size);
+    return arena;
+}
+
+// Input: arena - an arena handle
+// Output: none
+// Precondition: arena was returned by vlad_arena_create()
+// Postcondition: all of the arena's memory, including every block still
+//                allocated from it, is released and the handle is invalid
+
+void vlad_arena_destroy(vlad_arena_t *arena)
+{
+    arena_release(arena);
+    munmap(arena, sizeof(vlad_arena_t));
+}
+
+// Input: arena - an arena handle, object - any pointer
+// Output: whether object lies within the memory reserved for the arena
+// Precondition: arena was returned by vlad_arena_create()
+// Postcondition: none
+//
+// (Says nothing of whether object is allocated, only that it can only have
+//  come from this arena.)
+
+int vlad_arena_contains(vlad_arena_t *arena, void *object)
+{
+    return (byte *)object >= arena->memory && (byte *)object < arena->memory + arena->memory_size;
+}
+
+// Input: arena - an arena handle
+// Output: none
+// Precondition: no other thread is using the arena
+// Postcondition: every block allocated from the arena is freed at once
+
+void vlad_arena_reset(vlad_arena_t *arena)
+{
+#ifdef VLAD_THREADS
+    pthread_key_delete(arena->cache_key);
+#endif
+    arena_clear(arena);
+}
+
+void vlad_arena_lock(vlad_arena_t *arena)
+{
+    (void)arena;
+    heap_lock(arena);
+}
+
+void vlad_arena_unlock(vlad_arena_t *arena)
+{
+    (void)arena;
+    heap_unlock_unchecked(arena);
+}
+
+// Input: arena - an arena handle, n - number of bytes requested
+// Output: p - a pointer, or NULL
+// Precondition: n is < size of memory available to the arena
+// Postcondition: If a region of size n or greater cannot be found, p = NULL
+//                Else, p points to a location immediately after a header block
+//                      for a newly-allocated region of some size >=
+//                      n + header size.
+
+static void *arena_malloc(vlad_arena_t *arena, u_int32_t size)
+{
+    if (!arena->memory || size > arena->chunk_size - OBJECT_OFFSET)
+        return NULL;
+
+    u_int32_t class = get_class(arena, size);
+
+    vsize_t granted = class < NUM_CLASSES ? class_size(class) : get_block_size(OBJECT_OFFSET + size);
+
+#ifdef VLAD_THREADS
+    thread_cache_t *cache;
+    if (class < NUM_CLASSES && (cache = get_cache(arena))) {
+        void *object = cache_alloc(cache, class);
+        if (object) {
+            cache->requested += size;
+            cache->granted += granted;
+        }
+        return object;
+    }
+#endif
+
+    heap_lock(arena);
+    void *object = class < NUM_CLASSES ? class_alloc(arena, class) : block_alloc(arena, granted);
+    if (object) {
+        arena->requested += size;
+        arena->granted += granted;
+    }
+    heap_unlock(arena);
+
+    return object;
+}
+
+// Allocates n bytes at an address `skew` bytes short of a multiple of
+// `alignment`, or returns NULL.
+// Precondition: alignment is a power of two, and skew a multiple of 16
+//
+// (Blocks are aligned to their size, so the object goes at whatever offset
+//  in a block of at least `alignment` bytes gives it the right address. In
+//  headerless builds, that is usually the start of the block, so nothing is
+//  wasted beyond rounding up to the alignment. Slab slots whose size is a
+//  multiple of the alignment are aligned to it too, since slabs are page
+//  aligned and the first slot is SLAB_FIRST_SLOT bytes in.)
+
+static void *arena_memalign(vlad_arena_t *arena, u_int32_t alignment, u_int32_t skew,
+                            u_int32_t n)
+{
+    if (alignment < 16)
+        alignment = 16;
+    if (!skew && alignment == 16)
+        return arena_malloc(arena, n);
+    if (!arena->memory || alignment > arena->chunk_size)
+        return NULL;
+
+    if (!skew && arena->slabs && alignment <= SLAB_FIRST_SLOT && n <= SLAB_MAX_SIZE) {
+        u_int32_t class = slab_class_of[(n + 15) / 16];
+        while (slab_sizes[class] % alignment)
+            ++class;
+        return arena_malloc(arena, slab_sizes[class]);
+    }
+
+    // offset is a multiple of 16, so it is only too small for a header at 0
+    vaddr_t offset = (alignment - skew) & (alignment - 1);
+    if (!offset && OBJECT_OFFSET)
+        offset = alignment;
+    if (n > arena->chunk_size - offset)
+        return NULL;
+
+    // Even an empty object must start inside its block
+    vsize_t size = get_block_size(offset + (n ? n : 1));
+    if (size < alignment)
+        size = alignment;
+    if (size > arena->chunk_size)
+        return NULL;
+
+    heap_lock(arena);
+    free_header_t *node = heap_alloc(arena, size);
+    if (node) {
+        arena->requested += n;
+        arena->granted += size;
+    }
+    heap_unlock(arena);
+    if (!node)
+        return NULL;
+
+    byte *object = (byte *)node + offset;
+    if (offset != OBJECT_OFFSET) {
+        free_header_t *marker = nodeToObject(node);
+        marker->magic = MAGIC_ALIGNED;
+        marker->size = offset;
+        *((free_header_t *)object - 1) = *marker;
+    }
+    return object;
+}
+
+// Input: arena - an arena handle, object - a pointer
+// Output: none
+// Precondition: object was returned by vlad_arena_malloc(arena, ...)
+// Postcondition: The region pointed to by object can be re-allocated by
+//                vlad_arena_malloc(arena, ...)
+
+static void arena_free(vlad_arena_t *arena, void *object)
+{
+    u_int32_t class = get_object_class(arena, object);
+
+#ifdef VLAD_THREADS
+    thread_cache_t *cache;
+    if (class < NUM_CLASSES && (cache = get_cache(arena))) {
+        cache_free(cache, class, object);
+        return;
+    }
+#endif
+
+    heap_lock(arena);
+    if (class < NUM_CLASSES)
+        class_free(arena, class, object);
+    else
+        block_free(arena, object);
+    heap_unlock(arena);
+}
+
+// Input: arena - an arena handle, n - number of bytes requested per object,
+//        count - number of objects, objects - where to put them
+// Output: number of objects allocated
+// Precondition: objects has room for count pointers
+// Postcondition: As for count calls to vlad_arena_malloc(arena, n), with the
+//                results in objects[0] onwards, except that it stops at the
+//                first one that fails
+//
+// (Bigger objects are all cut from one block at a time, so they tend to be
+//  next to each other in memory, and a single lock is taken for the lot)
+
+static u_int32_t arena_malloc_batch(vlad_arena_t *arena, u_int32_t n, u_int32_t count,
+                                    void **objects)
+{
+    if (!arena->memory || n > arena->chunk_size - OBJECT_OFFSET)
+        return 0;
+
+    u_int32_t class = get_class(arena, n);
+    vsize_t size = class < NUM_CLASSES ? class_size(class) : get_block_size(OBJECT_OFFSET + n);
+
+    heap_lock(arena);
+    u_int32_t done = class < NUM_CLASSES ? class_alloc_batch(arena, class, count, objects) :
+        block_alloc_batch(arena, size, count, objects);
+    arena->requested += (uint64_t)n * done;
+    arena->granted += (uint64_t)size * done;
+    heap_unlock(arena);
+
+    return done;
+}
+
+static int compare_addresses(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(void *const *)a;
+    uintptr_t y = (uintptr_t)*(void *const *)b;
+    return (x > y) - (x < y);
+}
+
+// Input: arena - an arena handle, objects - pointers to free,
+//        count - number of pointers
+// Output: none
+// Precondition: each of objects[] was returned by vlad_arena_malloc(arena, ...)
+// Postcondition: As for vlad_arena_free(arena, ...) on each of objects[],
+//                which is left sorted by address
+//
+// (Neighbouring objects are merged with each other before any of them goes
+//  back on a free list, and a single lock is taken for the lot)
+
+static void arena_free_batch(vlad_arena_t *arena, void **objects, u_int32_t count)
+{
+    qsort(objects, count, sizeof(void *), compare_addresses);
 
-#ifndef _ISOC11_SOURCE
-    // For memalign()
-    #include <malloc.h>
-#endif
+    heap_lock(arena);
 
-#define HEADER_SIZE    sizeof(struct free_list_header)
-#define MIN_ALLOC (1 << 5) // Double the header size
-#define MIN_INIT_ALLOC (1 << 9)
-#define MAGIC_FREE     0xDEADBEEF
-#define MAGIC_ALLOC    0xBEEFDEAD
+    // Blocks are freed in runs between slab objects
+    u_int32_t start = 0;
+    for (u_int32_t i = 0; i <= count; ++i) {
+        if (i < count && get_object_class(arena, objects[i]) >= NUM_SLAB_CLASSES)
+            continue;
 
-typedef unsigned char byte;
-typedef u_int32_t vlink_t;
-typedef u_int32_t vsize_t;
-typedef u_int32_t vaddr_t;
+        block_free_sorted(arena, &objects[start], i - start);
+        if (i < count) {
+            slab_free(arena, objects[i]);
+            start = i + 1;
+        }
+    }
 
-typedef struct free_list_header {
-    u_int32_t magic; // ought to contain MAGIC_FREE
-    vsize_t size;    // # bytes in this block (including header)
-    vlink_t next;    // memory[] index of next free block
-    vlink_t prev;    // memory[] index of previous free block
-} free_header_t;
+    heap_unlock(arena);
+}
 
-// Global data
+// Input: arena - an arena handle, object - a pointer or NULL,
+//        n - number of bytes requested
+// Output: p - a pointer, or NULL
+// Precondition: object is NULL or was returned by vlad_arena_malloc(arena, ...)
+// Postcondition: If n is 0, object is freed and p = NULL
+//                Else if a region of n bytes cannot be found, p = NULL and
+//                      object is untouched
+//                Else, p points to a region of n or more bytes, that starts
+//                      with the first n bytes of object, and object is freed
+//                      (unless p = object)
+
+static void *arena_realloc(vlad_arena_t *arena, void *object, u_int32_t n)
+{
+    if (!object)
+        return arena_malloc(arena, n);
+    if (!n) {
+        arena_free(arena, object);
+        return NULL;
+    }
+
+    u_int32_t class = get_object_class(arena, object);
+    u_int32_t oldSize;
+    if (class < NUM_SLAB_CLASSES) {
+        oldSize = slab_sizes[class];
+        if (n <= oldSize && n > (class ? slab_sizes[class - 1] : 0)) {
+            count_alloc(arena, n, oldSize);
+            return object;
+        }
+    } else {
+        free_header_t *node = object_block(arena, object);
+        vaddr_t offset = (byte *)object - (byte *)node;
+        oldSize = block_size(arena, node) - offset;
+
+        // Something small enough for a slab is better off moving into one
+        if (n > SLAB_MAX_SIZE || !arena->slabs) {
+            if (n > arena->chunk_size - offset)
+                return NULL;
+
+            heap_lock(arena);
+            bool resized = block_resize(arena, node, get_block_size(offset + n));
+            if (resized) {
+                arena->requested += n;
+                arena->granted += block_size(arena, node);
+            }
+            heap_unlock(arena);
+            if (resized)
+                return object;
+        }
+    }
 
-static byte *memory = NULL;   // pointer to start of allocator memory
-static vaddr_t free_list_ptr; // index in memory[] of first block in free list
-static vsize_t memory_size;   // number of bytes malloc'd in memory[]
+    void *newObject = arena_malloc(arena, n);
+    if (newObject) {
+        memcpy(newObject, object, n < oldSize ? n : oldSize);
+        arena_free(arena, object);
+    }
+    return newObject;
+}
 
-static inline u_int32_t get_block_size(u_int32_t n)
+// Input: arena - an arena handle, count - number of elements,
+//        size - number of bytes per element
+// Output: p - a pointer, or NULL
+// Precondition: none
+// Postcondition: as for vlad_arena_malloc(arena, count * size), except
+//                that the region is zeroed
+
+void *vlad_arena_calloc(vlad_arena_t *arena, u_int32_t count, u_int32_t size)
 {
-    if (n <= MIN_ALLOC)
-        return MIN_ALLOC;
+    if (size && count > UINT32_MAX / size)
+        return NULL;
 
-    --n;
-    n |= n >> 1;
-    n |= n >> 2;
-    n |= n >> 4;
-    n |= n >> 8;
-    n |= n >> 16;
-    ++n;
+    void *object = vlad_arena_malloc(arena, count * size);
+    if (object)
+        memset(object, 0, count * size);
+    return object;
+}
 
-    return n;
+// Input: arena - an arena handle, object - a pointer
+// Output: n - number of bytes usable at object
+// Precondition: object was returned by vlad_arena_malloc(arena, ...)
+// Postcondition: none
+
+static u_int32_t arena_usable_size(vlad_arena_t *arena, void *object)
+{
+    u_int32_t class = get_object_class(arena, object);
+    if (class < NUM_SLAB_CLASSES)
+        return slab_sizes[class];
+    free_header_t *node = object_block(arena, object);
+    return block_size(arena, node) - ((byte *)object - (byte *)node);
 }
 
-static inline free_header_t *indexToNode(vlink_t index)
+#ifdef VLAD_DEBUG
+
+// In debug builds, every object is handed out with a red zone on either side
+// of it: RED_ZONE bytes in front, which also hold its size and state, and the
+// rest of its block behind it. Both are filled with a known pattern, and
+// checked when the object is freed and by vlad_check_heap(). Freed objects
+// can also be held back in quarantine for a while, filled with poison, so
+// that writes made to them after they were freed are caught too.
+
+#define RED_ZONE       16
+#define RED_ZONE_BYTE  0xFD
+#define POISON_BYTE    0xDD
+#define DEBUG_LIVE     0x11FEDEAD
+#define DEBUG_FREED    0xF4EEDEAD
+
+typedef struct debug_prefix {
+    u_int32_t size;  // # bytes requested
+    u_int32_t magic; // DEBUG_LIVE, or DEBUG_FREED while in quarantine
+    byte guard[RED_ZONE - 2 * sizeof(u_int32_t)];
+} debug_prefix_t;
+
+// Checks the red zones of the object behind a prefix, and its poison if it
+// is in quarantine. Returns what is wrong with it, or NULL if nothing is.
+// Aborts if the prefix is not at the start of an allocated object at all.
+
+static const char *debug_check_object(vlad_arena_t *arena, debug_prefix_t *prefix)
 {
-    return (free_header_t *)&memory[index];
+    u_int32_t usable = arena_usable_size(arena, prefix) - RED_ZONE;
+    byte *object = (byte *)(prefix + 1);
+
+    if (prefix->magic != DEBUG_LIVE && prefix->magic != DEBUG_FREED)
+        return "front red zone overwritten";
+    for (u_int32_t i = 0; i < sizeof(prefix->guard); ++i)
+        if (prefix->guard[i] != RED_ZONE_BYTE)
+            return "front red zone overwritten";
+    if (prefix->size > usable)
+        return "front red zone overwritten";
+
+    for (u_int32_t i = prefix->size; i < usable; ++i)
+        if (object[i] != RED_ZONE_BYTE)
+            return "back red zone overwritten";
+
+    if (prefix->magic == DEBUG_FREED)
+        for (u_int32_t i = 0; i < prefix->size; ++i)
+            if (object[i] != POISON_BYTE)
+                return "freed object written to";
+
+    return NULL;
 }
 
-static inline vlink_t nodeToIndex(free_header_t *node)
+static void debug_fail(vlad_arena_t *arena, void *object, const char *problem)
 {
-    return (byte *)node - memory;
+    fprintf(stderr, "vlad: object at offset %ld: %s\n", (long)((byte *)object - arena->memory),
+        problem);
+    abort();
 }
 
-// Input: size - number of bytes to make available to the allocator
-// Output: none
-// Precondition: Size is a power of two.
-// Postcondition: `size` bytes are now available to the allocator
-//
-// (If the allocator is already initialised, this function does nothing,
-//  even if it was initialised with different size)
+// Checks a live object's red zones, returning its prefix
+static debug_prefix_t *debug_prefix(vlad_arena_t *arena, void *object)
+{
+    debug_prefix_t *prefix = (debug_prefix_t *)object - 1;
+    const char *problem = debug_check_object(arena, prefix);
+    if (!problem && prefix->magic != DEBUG_LIVE)
+        problem = "object freed twice";
+    if (problem)
+        debug_fail(arena, object, problem);
+    return prefix;
+}
 
-void vlad_init(u_int32_t size)
+// Sets up the red zones of a newly allocated n-byte object, returning it
+static void *debug_object(vlad_arena_t *arena, debug_prefix_t *prefix, u_int32_t n)
 {
-    size = size < MIN_INIT_ALLOC ? MIN_INIT_ALLOC : get_block_size(size);
-#ifdef _ISOC11_SOURCE
-    memory = aligned_alloc(size, size);
-#else
-    memory = memalign(size, size);
-#endif
-    if (!memory) {
-        fprintf(stderr, "vlad_init: insufficient memory");
-        abort();
+    u_int32_t usable = arena_usable_size(arena, prefix) - RED_ZONE;
+    prefix->size = n;
+    prefix->magic = DEBUG_LIVE;
+    memset(prefix->guard, RED_ZONE_BYTE, sizeof(prefix->guard));
+    memset((byte *)(prefix + 1) + n, RED_ZONE_BYTE, usable - n);
+    return prefix + 1;
+}
+
+static void *debug_malloc(vlad_arena_t *arena, u_int32_t n)
+{
+    if (n > UINT32_MAX - 2 * RED_ZONE)
+        return NULL;
+
+    debug_prefix_t *prefix = arena_malloc(arena, n + 2 * RED_ZONE);
+    return prefix ? debug_object(arena, prefix, n) : NULL;
+}
+
+static void *debug_memalign(vlad_arena_t *arena, u_int32_t alignment, u_int32_t n)
+{
+    if (n > UINT32_MAX - 2 * RED_ZONE)
+        return NULL;
+
+    debug_prefix_t *prefix = arena_memalign(arena, alignment, RED_ZONE, n + 2 * RED_ZONE);
+    return prefix ? debug_object(arena, prefix, n) : NULL;
+}
+
+// Frees an object, or puts it in quarantine and frees the one that has been
+// there longest
+
+static void debug_free(vlad_arena_t *arena, void *object)
+{
+    debug_prefix_t *prefix = debug_prefix(arena, object);
+    if (!arena->quarantine_size) {
+        arena_free(arena, prefix);
+        return;
     }
 
-    free_header_t *node = indexToNode(0);
-    node->magic = MAGIC_FREE;
-    node->size = size;
-    node->next = 0;
-    node->prev = 0;
+    prefix->magic = DEBUG_FREED;
+    memset(object, POISON_BYTE, prefix->size);
+
+    heap_lock(arena);
+    debug_prefix_t *oldest = NULL;
+    if (arena->quarantine_count == arena->quarantine_size)
+        oldest = arena->quarantine[arena->quarantine_next];
+    else
+        ++arena->quarantine_count;
+    arena->quarantine[arena->quarantine_next] = prefix;
+    arena->quarantine_next = (arena->quarantine_next + 1) % arena->quarantine_size;
+    heap_unlock(arena);
+
+    if (oldest) {
+        const char *problem = debug_check_object(arena, oldest);
+        if (problem)
+            debug_fail(arena, oldest + 1, problem);
+        arena_free(arena, oldest);
+    }
+}
+
+static void *debug_realloc(vlad_arena_t *arena, void *object, u_int32_t n)
+{
+    if (!object)
+        return debug_malloc(arena, n);
+    if (!n) {
+        debug_free(arena, object);
+        return NULL;
+    }
+    if (n > UINT32_MAX - 2 * RED_ZONE)
+        return NULL;
 
-    free_list_ptr = 0;
-    memory_size = size;
+    debug_prefix_t *prefix = arena_realloc(arena, debug_prefix(arena, object), n + 2 * RED_ZONE);
+    return prefix ? debug_object(arena, prefix, n) : NULL;
 }
 
+static u_int32_t debug_malloc_batch(vlad_arena_t *arena, u_int32_t n, u_int32_t count,
+                                    void **objects)
+{
+    if (n > UINT32_MAX - 2 * RED_ZONE)
+        return 0;
 
-// Input: n - number of bytes requested
+    u_int32_t done = arena_malloc_batch(arena, n + 2 * RED_ZONE, count, objects);
+    for (u_int32_t i = 0; i < done; ++i)
+        objects[i] = debug_object(arena, objects[i], n);
+    return done;
+}
+
+static void debug_free_batch(vlad_arena_t *arena, void **objects, u_int32_t count)
+{
+    if (arena->quarantine_size) {
+        qsort(objects, count, sizeof(void *), compare_addresses);
+        for (u_int32_t i = 0; i < count; ++i)
+            debug_free(arena, objects[i]);
+        return;
+    }
+
+    for (u_int32_t i = 0; i < count; ++i)
+        objects[i] = debug_prefix(arena, objects[i]);
+    arena_free_batch(arena, objects, count);
+    for (u_int32_t i = 0; i < count; ++i)
+        objects[i] = (debug_prefix_t *)objects[i] + 1;
+}
+
+// Checks the red zones of every allocated object, and the poison of every
+// object in quarantine, returning the offset of the first bad one or -1.
+// Precondition: the arena's lock is held, and heap_check() found nothing
+
+static long debug_check_objects(vlad_arena_t *arena)
+{
+    for (u_int32_t chunk = 0; chunk < arena->num_chunks; ++chunk) {
+        if (!chunk_is_mapped(arena, chunk))
+            continue;
+
+        vaddr_t offset = chunk * arena->chunk_size;
+        vaddr_t end = offset + arena->chunk_size;
+        for (; offset < end; offset += block_size(arena, indexToNode(arena, offset))) {
+            free_header_t *node = indexToNode(arena, offset);
+            u_int32_t magic = block_magic(arena, node);
+
+            if (magic == MAGIC_ALLOC) {
+                const char *problem = debug_check_object(arena, block_object(node));
+                if (problem)
+                    return heap_report((byte *)block_object(node) - arena->memory, problem);
+            } else if (magic == MAGIC_SLAB) {
+                slab_header_t *slab = (slab_header_t *)node;
+                for (u_int32_t slot = 0; slot < slab_slots[slab->class]; ++slot) {
+                    if (slab->free_map[slot / 32] & (1u << slot % 32))
+                        continue;
+
+                    byte *object = (byte *)slab + SLAB_FIRST_SLOT + slot * slab_sizes[slab->class];
+                    const char *problem = debug_check_object(arena, (debug_prefix_t *)object);
+                    if (problem)
+                        return heap_report(object - arena->memory, problem);
+                }
+            }
+        }
+    }
+
+    return -1;
+}
+
+#endif
+
+// Input: arena - an arena handle, n - number of bytes requested
 // Output: p - a pointer, or NULL
-// Precondition: n is < size of memory available to the allocator
-// Postcondition: If a region of size n or greater cannot be found, p = NULL
-//                Else, p points to a location immediately after a header block
-//                      for a newly-allocated region of some size >=
-//                      n + header size.
+// Precondition: n is < size of memory available to the arena
+// Postcondition: as for arena_malloc(), except that in debug builds the
+//                object is surrounded by red zones
+
+void *vlad_arena_malloc(vlad_arena_t *arena, u_int32_t n)
+{
+#ifdef VLAD_DEBUG
+    return debug_malloc(arena, n);
+#else
+    return arena_malloc(arena, n);
+#endif
+}
+
+// Input: arena - an arena handle, alignment - a power of two,
+//        n - number of bytes requested
+// Output: p - a pointer, or NULL
+// Precondition: none
+// Postcondition: as for vlad_arena_malloc(arena, n), except that p is a
+//                multiple of alignment, and p = NULL if alignment is not a
+//                power of two
+//
+// (Alignments of up to 64 bytes cost nothing extra for small objects, and in
+//  headerless builds nothing beyond rounding n up to the alignment.)
 
-void *vlad_malloc(u_int32_t size)
+void *vlad_arena_memalign(vlad_arena_t *arena, u_int32_t alignment, u_int32_t n)
 {
-    if (!memory)
+    if (!alignment || (alignment & (alignment - 1)))
         return NULL;
+#ifdef VLAD_DEBUG
+    return debug_memalign(arena, alignment, n);
+#else
+    return arena_memalign(arena, alignment, 0, n);
+#endif
+}
 
-    size = get_block_size(HEADER_SIZE + size);
+// As for arena_free(), arena_realloc(), arena_malloc_batch(),
+// arena_free_batch() and arena_usable_size(), but checking each object's
+// red zones in debug builds
 
-    free_header_t *node = indexToNode(free_list_ptr);
-    free_header_t *bestFitNode = NULL;
-    while (true) {
-        if (node->magic != MAGIC_FREE) {
-            fprintf(stderr, "Memory corruption");
-            abort();
-        }
+void vlad_arena_free(vlad_arena_t *arena, void *object)
+{
+#ifdef VLAD_DEBUG
+    debug_free(arena, object);
+#else
+    arena_free(arena, object);
+#endif
+}
 
-        if (size <= node->size && (!bestFitNode || node->size < bestFitNode->size))
-            bestFitNode = node;
+void *vlad_arena_realloc(vlad_arena_t *arena, void *object, u_int32_t n)
+{
+#ifdef VLAD_DEBUG
+    return debug_realloc(arena, object, n);
+#else
+    return arena_realloc(arena, object, n);
+#endif
+}
 
-        if (node->next == free_list_ptr)
-            break;
+u_int32_t vlad_arena_malloc_batch(vlad_arena_t *arena, u_int32_t n, u_int32_t count,
+                                  void **objects)
+{
+#ifdef VLAD_DEBUG
+    return debug_malloc_batch(arena, n, count, objects);
+#else
+    return arena_malloc_batch(arena, n, count, objects);
+#endif
+}
+
+void vlad_arena_free_batch(vlad_arena_t *arena, void **objects, u_int32_t count)
+{
+#ifdef VLAD_DEBUG
+    debug_free_batch(arena, objects, count);
+#else
+    arena_free_batch(arena, objects, count);
+#endif
+}
 
-        node = indexToNode(node->next);
+u_int32_t vlad_arena_usable_size(vlad_arena_t *arena, void *object)
+{
+#ifdef VLAD_DEBUG
+    return debug_prefix(arena, object)->size;
+#else
+    return arena_usable_size(arena, object);
+#endif
+}
+
+// Input: arena - an arena handle
+// Output: offset - where the first problem is, or -1 if there is none
+// Precondition: arena was returned by vlad_arena_create()
+// Postcondition: the first problem found, if any, is described on stderr
+
+long vlad_arena_check_heap(vlad_arena_t *arena)
+{
+    heap_lock(arena);
+    long bad = heap_check(arena, false);
+#ifdef VLAD_DEBUG
+    if (bad < 0)
+        bad = debug_check_objects(arena);
+#endif
+    heap_unlock_unchecked(arena);
+
+    return bad;
+}
+
+// Input: arena - an arena handle, count - number of objects to hold back
+// Output: none
+// Precondition: no other thread is using the arena
+// Postcondition: in debug builds, the last `count` objects freed are held
+//                in quarantine rather than being freed straight away
+
+void vlad_arena_set_quarantine(vlad_arena_t *arena, u_int32_t count)
+{
+#ifdef VLAD_DEBUG
+    while (arena->quarantine_count) {
+        u_int32_t oldest = (arena->quarantine_next + arena->quarantine_size -
+            arena->quarantine_count--) % arena->quarantine_size;
+        arena_free(arena, arena->quarantine[oldest]);
+    }
+    if (arena->quarantine)
+        munmap(arena->quarantine, arena->quarantine_size * sizeof(void *));
+
+    arena->quarantine = NULL;
+    arena->quarantine_size = arena->quarantine_next = 0;
+    if (count) {
+        arena->quarantine = mmap(NULL, count * sizeof(void *), PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (arena->quarantine == MAP_FAILED) {
+            arena->quarantine = NULL;
+            return;
+        }
+        arena->quarantine_size = count;
     }
-    node = bestFitNode;
+#else
+    (void)arena;
+    (void)count;
+#endif
+}
 
-    if (!node || node->size < size)
-        return NULL;
+// Input: arena - an arena handle, stats - where to put the statistics
+// Output: none
+// Precondition: arena was returned by vlad_arena_create()
+// Postcondition: *stats describes the arena as it is now
+//
+// (Every figure is kept up to date as blocks are allocated and freed, so
+//  this takes the same short time however big the heap is)
 
-    while (node->size > size) {
-        vsize_t newSize = node->size / 2;
+void vlad_arena_get_stats(vlad_arena_t *arena, struct vlad_stats *stats)
+{
+    heap_lock(arena);
 
-        free_header_t *newNode = (free_header_t *)((byte *)node + newSize);
-        newNode->magic = MAGIC_FREE;
-        newNode->size = newSize;
-        newNode->next = node->next;
-        newNode->prev = nodeToIndex(node);
-        indexToNode(newNode->next)->prev = nodeToIndex(newNode);
+#ifdef VLAD_THREADS
+    // Other threads' totals catch up whenever they next take the lock
+    thread_cache_t *cache = pthread_getspecific(arena->cache_key);
+    if (cache)
+        cache_count(cache);
+#endif
 
-        node->size = newSize;
-        node->next = nodeToIndex(newNode);
+    stats->bytes_mapped = (size_t)arena->mapped_chunks * arena->chunk_size;
+    stats->bytes_free = 0;
+    for (u_int32_t order = 0; order < NUM_ORDERS; ++order) {
+        stats->free_blocks[order] = arena->free_counts[order];
+        stats->bytes_free += (size_t)arena->free_counts[order] << order;
     }
+    stats->bytes_in_use = stats->bytes_mapped - stats->bytes_free;
+    stats->bytes_slab_free = arena->slab_free_bytes;
+    stats->largest_free = arena->free_orders ? 1u << (31 - __builtin_clz(arena->free_orders)) : 0;
+
+    stats->bytes_requested = arena->requested;
+    stats->bytes_granted = arena->granted;
+    stats->splits = arena->splits;
+    stats->coalesces = arena->coalesces;
+
+    heap_unlock(arena);
+}
+
+// Precondition: arena was returned by vlad_arena_create()
+// Postcondition: arena stats displayed on stdout
+
+void vlad_arena_stats(vlad_arena_t *arena)
+{
+    heap_lock(arena);
+    if (heap_check(arena, true) >= 0)
+        corrupted();
+    heap_unlock(arena);
+}
 
-    if (indexToNode(node->next) == node)
-        return NULL;
 
-    indexToNode(node->next)->prev = node->prev;
-    indexToNode(node->prev)->next = node->next;
-    if (free_list_ptr == nodeToIndex(node))
-        free_list_ptr = node->next;
+// Input: size - number of bytes to make available to the allocator
+// Output: none
+// Precondition: Size is a power of two.
+// Postcondition: `size` bytes are now available to the allocator
+//
+// (If the allocator is already initialised, this function does nothing,
+//  even if it was initialised with different size)
+
+void vlad_init(u_int32_t size)
+{
+    if (!default_arena.memory)
+        arena_init(&default_arena, size, size);
+}
+
 
-    node->magic = MAGIC_ALLOC;
+// Input: n - number of bytes requested
+// Output: p - a pointer, or NULL
+// Precondition: n is < size of memory available to the allocator
+// Postcondition: If a region of size n or greater cannot be found, p = NULL
+//                Else, p points to a location immediately after a header block
+//                      for a newly-allocated region of some size >=
+//                      n + header size.
 
-    return (byte *)node + HEADER_SIZE;
+void *vlad_malloc(u_int32_t n)
+{
+    void *object = vlad_arena_malloc(&default_arena, n);
+    if (hooks && object)
+        hooks->malloc(object, n);
+    return object;
 }
 
 
@@ -173,92 +2118,81 @@ void *vlad_malloc(u_int32_t size)
 
 void vlad_free(void *object)
 {
-    free_header_t *node = (free_header_t *)((byte *)object - HEADER_SIZE);
-    if (node->magic != MAGIC_ALLOC) {
-        fprintf(stderr, "Attempt to free non-allocated memory");
-        abort();
-    }
-    if (node->size != get_block_size(node->size)) {
-        fprintf(stderr, "Memory corruption");
-        abort();
-    }
+    if (hooks)
+        hooks->free(object);
+    vlad_arena_free(&default_arena, object);
+}
 
-    node->magic = MAGIC_FREE;
 
-    bool gotNextFreeNode = false;
-    while (true) {
-        free_header_t *buddyNode = (free_header_t *)((size_t)node ^ node->size);
-        if (buddyNode->magic == MAGIC_ALLOC || buddyNode->size != node->size) {
-            break;
-        } else if (buddyNode->magic != MAGIC_FREE) {
-            fprintf(stderr, "Memory corruption");
-            abort();
-        }
+// As for vlad_arena_realloc(), vlad_arena_calloc(),
+// vlad_arena_malloc_batch(), vlad_arena_free_batch() and
+// vlad_arena_usable_size(), on the default arena
 
-        if (!gotNextFreeNode) {
-            if (node < buddyNode) {
-                if (indexToNode(buddyNode->next) == buddyNode) {
-                    assert(buddyNode->next == free_list_ptr);
-
-                    node->next = nodeToIndex(node);
-                    node->prev = nodeToIndex(node);
-                    free_list_ptr = nodeToIndex(node);
-                } else {
-                    node->next = buddyNode->next;
-                    node->prev = buddyNode->prev;
-                    indexToNode(node->next)->prev = nodeToIndex(node);
-                    indexToNode(node->prev)->next = nodeToIndex(node);
-                    if (free_list_ptr == nodeToIndex(buddyNode))
-                        free_list_ptr = nodeToIndex(node);
-                }
-            } else {
-                node = buddyNode;
-            }
-        } else {
-            if (node < buddyNode) {
-                assert(indexToNode(node->next) == buddyNode);
+void *vlad_realloc(void *object, u_int32_t n)
+{
+    if (!hooks)
+        return vlad_arena_realloc(&default_arena, object, n);
 
-                indexToNode(buddyNode->next)->prev = nodeToIndex(node);
-                node->next = buddyNode->next;
-            } else {
-                assert(indexToNode(node->prev) == buddyNode);
+    if (!object)
+        return vlad_malloc(n);
+    if (!n) {
+        vlad_free(object);
+        return NULL;
+    }
 
-                indexToNode(node->next)->prev = nodeToIndex(buddyNode);
-                buddyNode->next = node->next;
-                node = buddyNode;
-            }
-        }
-        node->size *= 2;
+    void *newObject = vlad_arena_realloc(&default_arena, object, n);
+    if (newObject)
+        hooks->realloc(object, newObject, n);
+    return newObject;
+}
 
-        gotNextFreeNode = true;
-    }
+void *vlad_memalign(u_int32_t alignment, u_int32_t n)
+{
+    void *object = vlad_arena_memalign(&default_arena, alignment, n);
+    if (hooks && object)
+        hooks->malloc(object, n);
+    return object;
+}
 
-    if (!gotNextFreeNode) {
-        free_header_t *prevNode = indexToNode(indexToNode(free_list_ptr)->prev);
-        while (true) {
-            if (prevNode->magic != MAGIC_FREE) {
-                fprintf(stderr, "Memory corruption");
-                abort();
-            }
+void *vlad_calloc(u_int32_t count, u_int32_t size)
+{
+    void *object = vlad_arena_calloc(&default_arena, count, size);
+    if (hooks && object)
+        hooks->malloc(object, count * size);
+    return object;
+}
 
-            if (prevNode < node)
-                break;
+u_int32_t vlad_malloc_batch(u_int32_t n, u_int32_t count, void **objects)
+{
+    u_int32_t done = vlad_arena_malloc_batch(&default_arena, n, count, objects);
+    if (hooks)
+        for (u_int32_t i = 0; i < done; ++i)
+            hooks->malloc(objects[i], n);
+    return done;
+}
 
-            if (nodeToIndex(prevNode) == free_list_ptr) {
-                // Reached the start of the list without finding a lower addressed node, so prepend to it
-                prevNode = indexToNode(prevNode->prev);
-                free_list_ptr = nodeToIndex(node);
-                break;
-            }
+void vlad_free_batch(void **objects, u_int32_t count)
+{
+    if (hooks)
+        for (u_int32_t i = 0; i < count; ++i)
+            hooks->free(objects[i]);
+    vlad_arena_free_batch(&default_arena, objects, count);
+}
 
-            prevNode = indexToNode(prevNode->prev);
-        }
+u_int32_t vlad_usable_size(void *object)
+{
+    return vlad_arena_usable_size(&default_arena, object);
+}
 
-        node->prev = nodeToIndex(prevNode);
-        node->next = prevNode->next;
-        indexToNode(prevNode->next)->prev = nodeToIndex(node);
-        prevNode->next = nodeToIndex(node);
-    }
+
+// Input: newHooks - functions to call, or NULL to stop calling them
+// Output: none
+// Precondition: newHooks stays valid until it is replaced
+// Postcondition: newHooks are called on every vlad_malloc() and friends
+
+void vlad_set_hooks(const vlad_hooks_t *newHooks)
+{
+    hooks = newHooks;
 }
 
 
@@ -268,8 +2202,8 @@ void vlad_free(void *object)
 
 void vlad_end(void)
 {
-    free(memory);
-    memory = NULL;
+    if (default_arena.memory)
+        arena_release(&default_arena);
 }
 
 
@@ -278,27 +2212,32 @@ void vlad_end(void)
 
 void vlad_stats(void)
 {
-    free_header_t *node = indexToNode(free_list_ptr);
-    size_t n = 0;
-    while (true) {
-        printf("%zu:\t%p:%u\n", ++n, (void*)node, node->size);
+    vlad_arena_stats(&default_arena);
+}
+
 
-        assert(node->magic == MAGIC_FREE);
-        assert(indexToNode(node->next)->prev == nodeToIndex(node));
-        assert(((size_t)node & ~(node->size - 1)) == (size_t)node);
+// Input: stats - where to put the statistics
+// Output: none
+// Precondition: allocator has been vlad_init()'d
+// Postcondition: *stats describes the allocator as it is now
 
-        free_header_t *buddyNode = (free_header_t *)((size_t)node ^ node->size);
-        assert(buddyNode->magic != MAGIC_FREE || buddyNode->size != node->size);
+void vlad_get_stats(struct vlad_stats *stats)
+{
+    vlad_arena_get_stats(&default_arena, stats);
+}
 
-        if (node->next == free_list_ptr) {
-            break;
-        } else {
-            assert(indexToNode(node->next) > node);
-            assert((byte *)node + node->size <= (byte *)indexToNode(node->next));
-        }
 
-        node = indexToNode(node->next);
-    }
+// As for vlad_arena_check_heap() and vlad_arena_set_quarantine(), on the
+// default arena
+
+long vlad_check_heap(void)
+{
+    return vlad_arena_check_heap(&default_arena);
+}
+
+void vlad_set_quarantine(u_int32_t count)
+{
+    vlad_arena_set_quarantine(&default_arena, count);
 }
 
 
@@ -340,15 +2279,25 @@ void vlad_stats(void)
 typedef struct point {int x, y;} point;
 
 static point offset_to_point(int offset,  int size, int is_end);
-static void fill_block(char graph[STAT_HEIGHT][STAT_WIDTH][20],
+static void fill_block(vlad_arena_t *arena,
+                        char graph[STAT_HEIGHT][STAT_WIDTH][20],
                         int offset, char * label);
 
 
 
+// Print fancy 2D view of the default arena
+void vlad_reveal(void **alpha)
+{
+    vlad_arena_reveal(&default_arena, alpha);
+}
+
 // Print fancy 2D view of memory
 // Note, This is limited to memory_sizes of under 16MB
-void vlad_reveal(void *alpha[26])
+// (and only shows the first chunk of a growable arena)
+void vlad_arena_reveal(vlad_arena_t *arena, void **alpha)
 {
+    byte *memory = arena->memory;
+    vsize_t memory_size = arena->chunk_size;
     int i, j;
     vlink_t offset;
     char graph[STAT_HEIGHT][STAT_WIDTH][20];
@@ -370,25 +2319,25 @@ void vlad_reveal(void *alpha[26])
     free_count = 0;
     while (offset < memory_size){
         block = (free_header_t *)(memory + offset);
-        if (block->magic == MAGIC_FREE) {
+        if (block_magic(arena, block) == MAGIC_FREE) {
             snprintf(free_sizes[free_count++], 32,
-                "%d) %d bytes", i, block->size);
-            snprintf(label, 3, "%d", i++);
-            fill_block(graph, offset,label);
+                "%d) %d bytes", i, block_size(arena, block));
+            snprintf(label, 3, "%u", (unsigned)i++ % 100);
+            fill_block(arena, graph, offset,label);
         }
-        offset += block->size;
+        offset += block_size(arena, block);
     }
 
     // Fill graph with allocated memory
     alloc_count = 0;
     for (i=0; i<26; i++) {
         if (alpha[i] != NULL) {
-            offset = ((byte *) alpha[i] - (byte *) memory) - HEADER_SIZE;
+            offset = ((byte *) alpha[i] - (byte *) memory) - OBJECT_OFFSET;
             block = (free_header_t *)(memory + offset);
             snprintf(alloc_sizes[alloc_count++], 32,
-                "%c) %d bytes", 'a' + i, block->size);
+                "%c) %d bytes", 'a' + i, block_size(arena, block));
             snprintf(label, 3, "%c", 'a' + i);
-            fill_block(graph, offset,label);
+            fill_block(arena, graph, offset,label);
         }
     }
 
@@ -415,17 +2364,20 @@ void vlad_reveal(void *alpha[26])
 }
 
 // Fill block area
-static void fill_block(char graph[STAT_HEIGHT][STAT_WIDTH][20],
+static void fill_block(vlad_arena_t *arena,
+                        char graph[STAT_HEIGHT][STAT_WIDTH][20],
                         int offset, char * label)
 {
+    byte *memory = arena->memory;
+    vsize_t memory_size = arena->chunk_size;
     point start, end;
     free_header_t * block;
     char * color;
     char text[3];
     block = (free_header_t *)(memory + offset);
     start = offset_to_point(offset, memory_size, 0);
-    end = offset_to_point(offset + block->size, memory_size, 1);
-    color = (block->magic == MAGIC_FREE) ? BG_FREE: BG_ALLOC;
+    end = offset_to_point(offset + block_size(arena, block), memory_size, 1);
+    color = (block_magic(arena, block) == MAGIC_FREE) ? BG_FREE: BG_ALLOC;
 
     int x, y;
     for (y=start.y; y < end.y; y++) {
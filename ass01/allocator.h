@@ -15,6 +15,28 @@
 
 typedef uint32_t u_int32_t;
 
+// When allocator.c is compiled with VLAD_THREADS defined, vlad_malloc and
+// vlad_free may be called from any number of threads at once. Small blocks
+// are then served from per-thread caches, so a block that is free in one
+// thread's cache cannot be handed out to another thread until the cache
+// overflows or its thread exits.
+// vlad_init and vlad_end must still not race with any other call.
+
+// When allocator.c is compiled with VLAD_HEADERLESS defined, allocated blocks
+// carry no header at all: the size and state of every block are kept in a
+// side map of one byte per 16 bytes of arena, and objects start right at the
+// start of their block. A 16-byte request then takes a 16-byte block rather
+// than a 32-byte one, for 1/16 of the arena's size in extra memory.
+
+// An arena is an independent heap with its own memory. vlad_init() and
+// friends below all work on a single default arena.
+//
+// In arenas of 64KB or more (per chunk), requests of up to 256 bytes are
+// packed into slabs of equal-sized slots with no header per object, so for
+// those the "header block" mentioned below is not really there.
+
+typedef struct vlad_arena vlad_arena_t;
+
 // Input: size - number of bytes to make available to the allocator
 // Output: none
 // Precondition: Size is a power of two.
@@ -44,6 +66,92 @@ void *vlad_malloc(u_int32_t n);
 
 void vlad_free(void *object);
 
+// Input: object - a pointer or NULL, n - number of bytes requested
+// Output: p - a pointer, or NULL
+// Precondition: object is NULL or was returned by vlad_malloc()
+// Postcondition: If n is 0, object is freed and p = NULL
+//                Else if a region of n bytes cannot be found, p = NULL and
+//                      object is untouched
+//                Else, p points to a region of n or more bytes, that starts
+//                      with the first n bytes of object, and object is freed
+//                      (unless p = object)
+//
+// (A block whose neighbouring buddies are free grows into them in place,
+//  and a block shrinks in place by freeing its upper halves, so the data is
+//  only copied when neither is possible)
+
+void *vlad_realloc(void *object, u_int32_t n);
+
+// Input: count - number of elements, size - number of bytes per element
+// Output: p - a pointer, or NULL
+// Precondition: none
+// Postcondition: as for vlad_malloc(count * size), except that the region
+//                is zeroed
+
+void *vlad_calloc(u_int32_t count, u_int32_t size);
+
+// Input: alignment - a power of two, n - number of bytes requested
+// Output: p - a pointer, or NULL
+// Precondition: none
+// Postcondition: as for vlad_malloc(n), except that p is a multiple of
+//                alignment, and p = NULL if alignment is not a power of two
+//
+// (Small objects aligned to up to 64 bytes come from slabs at no extra cost.
+//  Otherwise the object is put part way into a big enough block, except in
+//  headerless builds, where blocks start with their object and are aligned
+//  to their size, so nothing is wasted beyond rounding n up to alignment)
+
+void *vlad_memalign(u_int32_t alignment, u_int32_t n);
+
+// Input: n - number of bytes requested per object, count - number of
+//        objects, objects - where to put them
+// Output: number of objects allocated
+// Precondition: objects has room for count pointers
+// Postcondition: As for count calls to vlad_malloc(n), with the results in
+//                objects[0] onwards, except that it stops at the first one
+//                that fails
+//
+// (Bigger objects are all cut from one block at a time, so they tend to be
+//  next to each other in memory, and a single lock is taken for the lot)
+
+u_int32_t vlad_malloc_batch(u_int32_t n, u_int32_t count, void **objects);
+
+// Input: objects - pointers to free, count - number of pointers
+// Output: none
+// Precondition: each of objects[] was returned by vlad_malloc()
+// Postcondition: As for vlad_free() on each of objects[], which is left
+//                sorted by address
+//
+// (Neighbouring objects are merged with each other before any of them goes
+//  back on a free list, and a single lock is taken for the lot)
+
+void vlad_free_batch(void **objects, u_int32_t count);
+
+// Input: object - a pointer
+// Output: n - number of bytes usable at object
+// Precondition: object was returned by vlad_malloc()
+// Postcondition: none
+
+u_int32_t vlad_usable_size(void *object);
+
+// Functions to be told about every successful vlad_malloc(), vlad_memalign(),
+// vlad_calloc(), vlad_realloc() and vlad_free() on the default arena, e.g. to
+// record them. free is called just before the object is freed, the others
+// just after. None of them may be NULL.
+
+typedef struct vlad_hooks {
+    void (*malloc)(void *object, u_int32_t n);
+    void (*free)(void *object);
+    void (*realloc)(void *oldObject, void *newObject, u_int32_t n);
+} vlad_hooks_t;
+
+// Input: hooks - functions to call, or NULL to stop calling them
+// Output: none
+// Precondition: hooks stays valid until it is replaced
+// Postcondition: hooks are called on every vlad_malloc() and friends
+
+void vlad_set_hooks(const vlad_hooks_t *hooks);
+
 // Stop the allocator, so that it can be init'ed again:
 // Precondition: allocator memory was once allocated by vlad_init()
 // Postcondition: allocator is unusable until vlad_int() executed again
@@ -55,9 +163,143 @@ void vlad_end(void);
 
 void vlad_stats(void);
 
+// A snapshot of the allocator. Byte counts include block headers, and any
+// blocks that are parked in thread caches count as in use.
+//
+// bytes_granted - bytes_requested is the memory lost to rounding requests
+// up to a block or slot size, over every allocation so far. (An object's
+// requested size isn't kept, so this can't be worked out for just the
+// objects that are live.) With VLAD_THREADS, these two totals can lag behind
+// by what other threads allocated since they last took the arena's lock.
+
+struct vlad_stats {
+    size_t bytes_mapped;    // bytes of memory currently mapped in
+    size_t bytes_in_use;    // bytes in allocated blocks and slabs
+    size_t bytes_free;      // bytes in free blocks
+    size_t bytes_slab_free; // bytes in free slab slots (part of bytes_in_use)
+    size_t largest_free;    // size of the largest free block, or 0 if none
+    u_int32_t free_blocks[32]; // # free blocks of each size: 1 << i bytes
+
+    uint64_t bytes_requested; // total bytes asked for by all allocations
+    uint64_t bytes_granted;   // total bytes of memory given to them
+    uint64_t splits;          // # times a block was split in two
+    uint64_t coalesces;       // # times a block was merged with its buddy
+};
+
+// Input: stats - where to put the statistics
+// Output: none
+// Precondition: allocator has been vlad_init()'d
+// Postcondition: *stats describes the allocator as it is now
+//
+// (Every figure is kept up to date as blocks are allocated and freed, so
+//  this is cheap enough to call as often as you like)
+
+void vlad_get_stats(struct vlad_stats *stats);
+
+// When allocator.c is compiled with VLAD_DEBUG defined, the whole heap is
+// checked after every call, and each object has red zones on either side of
+// it that are checked when it is freed. Thread caches are not used. In
+// other builds, none of this costs anything.
+
+// Input: none
+// Output: offset - where the first problem is, or -1 if there is none
+// Precondition: allocator has been vlad_init()'d
+// Postcondition: the first problem found, if any, is described on stderr
+//
+// (Walks every block in address order, checking its header and the free
+//  lists. In debug builds, every object's red zones are checked as well.)
+
+long vlad_check_heap(void);
+
+// Input: count - number of freed objects to hold back
+// Output: none
+// Precondition: allocator has been vlad_init()'d
+// Postcondition: in debug builds, the last `count` objects freed are filled
+//                with poison and held in quarantine rather than being freed
+//                straight away, so that writes to them are caught when
+//                they leave; other builds ignore this
+
+void vlad_set_quarantine(u_int32_t count);
+
 // Precondition: allocator has been vlad_init()'d
 // Postcondition: allocator stats displayed graphically
 
-void vlad_reveal(void **);
+void vlad_reveal(void **alpha);
+
+// Input: size - number of bytes to make available to the arena
+// Output: arena - a handle for the new arena
+// Precondition: none
+// Postcondition: `size` bytes rounded up to a power of two are available to
+//                vlad_arena_malloc(arena, ...)
+
+vlad_arena_t *vlad_arena_create(u_int32_t size);
+
+// Input: chunk_size - number of bytes to add to the arena at a time
+//        max_size - number of bytes the arena may grow to
+// Output: arena - a handle for the new arena
+// Precondition: none
+// Postcondition: chunk_size bytes rounded up to a power of two are available
+//                to vlad_arena_malloc(arena, ...), and more chunks are added
+//                as needed until the arena reaches max_size bytes
+//
+// (No single allocation can be bigger than a chunk. Chunks that become
+//  wholly free are given back to the OS, apart from one kept spare.)
+
+vlad_arena_t *vlad_arena_create_growable(u_int32_t chunk_size, u_int32_t max_size);
+
+// Input: arena - an arena handle
+// Output: none
+// Precondition: arena was returned by vlad_arena_create()
+// Postcondition: all of the arena's memory, including every block still
+//                allocated from it, is released and the handle is invalid
+
+void vlad_arena_destroy(vlad_arena_t *arena);
+
+// Input: arena - an arena handle, object - any pointer
+// Output: whether object lies within the memory reserved for the arena
+// Precondition: arena was returned by vlad_arena_create()
+// Postcondition: none
+
+int vlad_arena_contains(vlad_arena_t *arena, void *object);
+
+// Input: arena - an arena handle
+// Output: none
+// Precondition: no other thread is using the arena
+// Postcondition: every block allocated from the arena is freed at once
+
+void vlad_arena_reset(vlad_arena_t *arena);
+
+// Input: arena - an arena handle
+// Output: none
+// Precondition: arena was returned by vlad_arena_create(); a thread that
+//               calls vlad_arena_lock() calls vlad_arena_unlock() before
+//               using the arena again
+// Postcondition: vlad_arena_lock() waits for every other thread to leave
+//                the arena's lock, and keeps them out of it until
+//                vlad_arena_unlock(); without VLAD_THREADS, both do nothing
+//
+// (For pthread_atfork() handlers, so that a child process never starts
+//  with the lock held by a thread it doesn't have)
+
+void vlad_arena_lock(vlad_arena_t *arena);
+void vlad_arena_unlock(vlad_arena_t *arena);
+
+// As for vlad_malloc(), vlad_free(), vlad_stats() and friends, but on the
+// given arena rather than the default one
+
+void *vlad_arena_malloc(vlad_arena_t *arena, u_int32_t n);
+void vlad_arena_free(vlad_arena_t *arena, void *object);
+void *vlad_arena_realloc(vlad_arena_t *arena, void *object, u_int32_t n);
+void *vlad_arena_calloc(vlad_arena_t *arena, u_int32_t count, u_int32_t size);
+void *vlad_arena_memalign(vlad_arena_t *arena, u_int32_t alignment, u_int32_t n);
+u_int32_t vlad_arena_malloc_batch(vlad_arena_t *arena, u_int32_t n, u_int32_t count,
+                                  void **objects);
+void vlad_arena_free_batch(vlad_arena_t *arena, void **objects, u_int32_t count);
+u_int32_t vlad_arena_usable_size(vlad_arena_t *arena, void *object);
+void vlad_arena_stats(vlad_arena_t *arena);
+void vlad_arena_get_stats(vlad_arena_t *arena, struct vlad_stats *stats);
+long vlad_arena_check_heap(vlad_arena_t *arena);
+void vlad_arena_set_quarantine(vlad_arena_t *arena, u_int32_t count);
+void vlad_arena_reveal(vlad_arena_t *arena, void **alpha);
 
 #endif
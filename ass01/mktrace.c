@@ -0,0 +1,84 @@
+//
+// COMP1927 Assignment 1 - Memory allocator trace generator
+// mktrace.c ... record a synthetic workload as an allocation trace
+//
+// Usage: ./mktrace trace-file [allocations]
+//
+// Runs a churn-heavy workload on vlad with tracing on. A pool of live
+// objects keeps having random members freed and replaced, mostly by small
+// objects, and now and then an object grows a step at a time the way a
+// dynamic array does.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "trace.h"
+
+#define MEMORY_SIZE (1 << 28)
+#define SLOTS 4096
+#define MAX_GROWTH (1 << 16)
+#define DEFAULT_ALLOCS 1000000
+
+static inline u_int32_t xorshift(u_int32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace-file [allocations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    long allocs = argc > 2 ? atol(argv[2]) : DEFAULT_ALLOCS;
+
+    vlad_init(MEMORY_SIZE);
+    if (!vlad_trace_start(argv[1])) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    void *slots[SLOTS] = {NULL};
+    u_int32_t sizes[SLOTS];
+    u_int32_t seed = 2463534242u;
+    for (long i = 0; i < allocs; ++i) {
+        u_int32_t r = xorshift(&seed);
+        u_int32_t slot = r % SLOTS;
+
+        if (slots[slot] && (r >> 12) % 8 == 0 && sizes[slot] < MAX_GROWTH) {
+            u_int32_t size = sizes[slot] + sizes[slot] / 2 + 16;
+            void *object = vlad_realloc(slots[slot], size);
+            // on failure, the old object (and its size) stays put
+            if (object) {
+                slots[slot] = object;
+                sizes[slot] = size;
+            }
+            continue;
+        }
+
+        if (slots[slot])
+            vlad_free(slots[slot]);
+
+        u_int32_t kind = (r >> 12) % 20;
+        if (kind < 16)
+            sizes[slot] = (r >> 17) % 64 + 1;
+        else if (kind < 19)
+            sizes[slot] = (r >> 17) % 1024 + 1;
+        else
+            sizes[slot] = (r >> 17) % 32768 + 1;
+        slots[slot] = vlad_malloc(sizes[slot]);
+    }
+
+    for (u_int32_t slot = 0; slot < SLOTS; ++slot)
+        if (slots[slot])
+            vlad_free(slots[slot]);
+
+    vlad_trace_stop();
+    vlad_end();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+//
+// COMP1927 Assignment 1 - Memory allocator trace replayer
+// replay.c ... run an allocation trace against vlad and the system malloc
+//
+// Usage: ./replay trace-file [timed runs]
+//
+// For each allocator, the trace is first replayed once to measure memory:
+//   peak live      - most bytes requested by live objects at any one time
+//   peak granted   - most bytes handed out (the usable size of live objects)
+//   peak RSS       - growth of the process' resident set over the replay
+//   internal frag  - 1 - peak live / peak granted
+//   total frag     - 1 - peak live / peak RSS
+// and is then replayed the given number of times (default 5) for the
+// median time per operation. Peak RSS needs Linux's /proc/self/clear_refs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+
+#include "allocator.h"
+#include "trace.h"
+
+#define VLAD_CHUNK_SIZE (1 << 24)
+#define VLAD_MAX_SIZE   (1u << 31)
+#define DEFAULT_RUNS 5
+
+typedef struct allocator {
+    const char *name;
+    void (*init)(void);
+    void *(*malloc)(size_t n);
+    void *(*realloc)(void *object, size_t n);
+    void (*free)(void *object);
+    size_t (*usable_size)(void *object);
+    void (*end)(void);
+} allocator_t;
+
+typedef struct memory_stats {
+    size_t peakLive;
+    size_t peakGranted;
+    long peakRss; // KB, or -1 if unknown
+} memory_stats_t;
+
+static vlad_arena_t *arena;
+
+static void vlad_replay_init(void)
+{
+    arena = vlad_arena_create_growable(VLAD_CHUNK_SIZE, VLAD_MAX_SIZE);
+}
+
+static void *vlad_replay_malloc(size_t n)
+{
+    return n > UINT32_MAX ? NULL : vlad_arena_malloc(arena, n);
+}
+
+static void *vlad_replay_realloc(void *object, size_t n)
+{
+    return n > UINT32_MAX ? NULL : vlad_arena_realloc(arena, object, n);
+}
+
+static void vlad_replay_free(void *object)
+{
+    vlad_arena_free(arena, object);
+}
+
+static size_t vlad_replay_usable_size(void *object)
+{
+    return vlad_arena_usable_size(arena, object);
+}
+
+static void vlad_replay_end(void)
+{
+    vlad_arena_destroy(arena);
+}
+
+static void system_init(void)
+{
+}
+
+static void system_end(void)
+{
+}
+
+static const allocator_t allocators[] = {
+    {"vlad", vlad_replay_init, vlad_replay_malloc, vlad_replay_realloc,
+        vlad_replay_free, vlad_replay_usable_size, vlad_replay_end},
+    {"malloc", system_init, malloc, realloc, free, malloc_usable_size, system_end}
+};
+
+// Reads a "Name:   N kB" field of /proc/self/status, or returns -1
+static long read_status_kb(const char *field)
+{
+    FILE *status = fopen("/proc/self/status", "r");
+    if (!status)
+        return -1;
+
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), status))
+        if (!strncmp(line, field, strlen(field)))
+            kb = atol(line + strlen(field));
+
+    fclose(status);
+    return kb;
+}
+
+// Makes VmHWM (peak RSS) start again from the current RSS
+static int reset_peak_rss(void)
+{
+    FILE *clearRefs = fopen("/proc/self/clear_refs", "w");
+    if (!clearRefs)
+        return 0;
+
+    fputs("5", clearRefs);
+    return fclose(clearRefs) == 0;
+}
+
+static void free_all(const allocator_t *a, void **objects, u_int32_t numIds)
+{
+    for (u_int32_t id = 0; id < numIds; ++id) {
+        if (objects[id])
+            a->free(objects[id]);
+        objects[id] = NULL;
+    }
+}
+
+// Replays the trace, filling every object like a real program would, and
+// keeps track of how much memory is live and handed out
+
+static size_t replay_measured(const allocator_t *a, trace_record_t *records, size_t count,
+                              void **objects, u_int32_t *sizes, u_int32_t numIds,
+                              memory_stats_t *stats)
+{
+    long baseRss = read_status_kb("VmRSS:");
+    int knowRss = baseRss >= 0 && reset_peak_rss();
+
+    size_t live = 0, granted = 0, failures = 0;
+    stats->peakLive = stats->peakGranted = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        trace_record_t *r = &records[i];
+        void *object = objects[r->id];
+
+        if (object) {
+            live -= sizes[r->id];
+            granted -= a->usable_size(object);
+        }
+
+        if (r->op == TRACE_FREE) {
+            if (object)
+                a->free(object);
+            objects[r->id] = NULL;
+            continue;
+        }
+
+        void *newObject = r->op == TRACE_REALLOC && object ?
+            a->realloc(object, r->size) : a->malloc(r->size);
+        if (!newObject) {
+            ++failures;
+            if (r->op == TRACE_REALLOC && object) {
+                live += sizes[r->id];
+                granted += a->usable_size(object);
+            }
+            continue;
+        }
+
+        if (r->size > sizes[r->id] || r->op == TRACE_MALLOC)
+            memset(newObject, 0xA5, r->size);
+        objects[r->id] = newObject;
+        sizes[r->id] = r->size;
+
+        live += r->size;
+        granted += a->usable_size(newObject);
+        if (live > stats->peakLive)
+            stats->peakLive = live;
+        if (granted > stats->peakGranted)
+            stats->peakGranted = granted;
+    }
+
+    long peakRss = knowRss ? read_status_kb("VmHWM:") : -1;
+    stats->peakRss = peakRss >= 0 ? peakRss - baseRss : -1;
+
+    free_all(a, objects, numIds);
+    return failures;
+}
+
+// Replays the trace as fast as possible, returning the time taken in ns
+
+static double replay_timed(const allocator_t *a, trace_record_t *records, size_t count,
+                           void **objects, u_int32_t numIds)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < count; ++i) {
+        trace_record_t *r = &records[i];
+        void **object = &objects[r->id];
+
+        if (r->op == TRACE_FREE) {
+            if (*object)
+                a->free(*object);
+            *object = NULL;
+        } else if (r->op == TRACE_REALLOC && *object) {
+            void *newObject = a->realloc(*object, r->size);
+            if (newObject)
+                *object = newObject;
+        } else {
+            *object = a->malloc(r->size);
+            if (*object)
+                *(char *)*object = 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free_all(a, objects, numIds);
+
+    return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s trace-file [timed runs]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+    if (runs < 1)
+        runs = 1;
+
+    size_t count;
+    u_int32_t numIds;
+    trace_record_t *records = trace_read(argv[1], &count, &numIds);
+    if (!records) {
+        fprintf(stderr, "%s: cannot read trace\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    void **objects = calloc(numIds, sizeof(void *));
+    u_int32_t *sizes = calloc(numIds, sizeof(u_int32_t));
+    double *times = malloc(runs * sizeof(double));
+    if (!objects || !sizes || !times) {
+        fprintf(stderr, "Insufficient memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu operations on %u objects\n", count, numIds);
+    printf("allocator\tns/op\tfailed\tpeak live KB\tpeak granted KB\tpeak RSS KB\t"
+        "internal frag\ttotal frag\n");
+
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); ++i) {
+        const allocator_t *a = &allocators[i];
+        a->init();
+
+        memory_stats_t stats;
+        size_t failures = replay_measured(a, records, count, objects, sizes, numIds, &stats);
+        for (int run = 0; run < runs; ++run)
+            times[run] = replay_timed(a, records, count, objects, numIds);
+        qsort(times, runs, sizeof(double), compare_doubles);
+
+        a->end();
+
+        printf("%s\t\t%.1f\t%zu\t%zu\t\t%zu\t\t", a->name, times[runs / 2] / count,
+            failures, stats.peakLive / 1024, stats.peakGranted / 1024);
+        if (stats.peakRss >= 0)
+            printf("%ld\t\t", stats.peakRss);
+        else
+            printf("?\t\t");
+        printf("%.3f\t\t", stats.peakGranted ? 1 - (double)stats.peakLive / stats.peakGranted : 0);
+        if (stats.peakRss > 0)
+            printf("%.3f\n", 1 - (double)stats.peakLive / (stats.peakRss * 1024.0));
+        else
+            printf("?\n");
+    }
+
+    free(records);
+    free(objects);
+    free(sizes);
+    free(times);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+//
+//  COMP1927 Assignment 1 - Vlad: the memory allocator
+//  runstat.c ... time a program with and without vlad as its malloc()
+//
+//  Usage: ./runstat shim input command [args ...]
+//
+//  Runs the command a few times with stdin from `input` and stdout thrown
+//  away, first as it is and then with LD_PRELOAD=shim, and reports the best
+//  wall time of each and the largest peak resident set size of any run
+//  (memory use, unlike time, isn't made worse by a busy machine, so the
+//  worst run is the honest one).
+//
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RUNS 3
+
+// Runs the command once, returning its wall time in seconds and setting
+// *maxRss to its peak resident set size in KB
+static double run(char *input, char **argv, long *maxRss)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (!pid) {
+        int in = open(input, O_RDONLY);
+        int out = open("/dev/null", O_WRONLY);
+        if (in < 0 || out < 0) {
+            perror(input);
+            _exit(127);
+        }
+        dup2(in, STDIN_FILENO);
+        dup2(out, STDOUT_FILENO);
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+        fprintf(stderr, "runstat: %s failed\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    *maxRss = usage.ru_maxrss;
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void report(const char *name, char *input, char **argv)
+{
+    double best = 0;
+    long peakRss = 0;
+    for (int i = 0; i < RUNS; ++i) {
+        long maxRss;
+        double seconds = run(input, argv, &maxRss);
+        if (!i || seconds < best)
+            best = seconds;
+        if (maxRss > peakRss)
+            peakRss = maxRss;
+    }
+
+    printf("  %-8s %8.3fs %8ldKB\n", name, best, peakRss);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s shim input command [args ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *shim = realpath(argv[1], NULL);
+    if (!shim) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s", argv[3]);
+    for (int i = 4; i < argc; ++i)
+        printf(" %s", argv[i]);
+    printf(" < %s\n", argv[2]);
+    fflush(stdout);
+
+    unsetenv("LD_PRELOAD");
+    report("malloc", argv[2], argv + 3);
+    setenv("LD_PRELOAD", shim, 1);
+    report("vlad", argv[2], argv + 3);
+
+    free(shim);
+    return EXIT_SUCCESS;
+}
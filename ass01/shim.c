@@ -0,0 +1,230 @@
+//
+//  COMP1927 Assignment 1 - Vlad: the memory allocator
+//  shim.c ... malloc() and friends on top of vlad, for LD_PRELOAD
+//
+//  Build libvlad.so, then run any program on vlad with
+//      LD_PRELOAD=./libvlad.so program ...
+//
+//  Everything is served from one growable arena, built thread-safe and
+//  headerless (so that aligned requests cost little), apart from requests
+//  too big to be worth a buddy block, which are mapped in from the OS on
+//  their own.
+//
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "allocator.h"
+
+#define CHUNK_SIZE (1 << 22)  // Bytes added to the arena at a time
+#define MAX_SIZE   (1u << 31) // Bytes the arena may grow to
+#define BIG_SIZE   (1 << 18)  // Bigger requests are mapped in on their own
+#define MIN_ALIGN  16         // What malloc() promises every object
+
+// Kept just before each big object
+typedef struct big_header {
+    size_t map_size; // # bytes mapped
+    size_t offset;   // # bytes from the start of the mapping to the object
+} big_header_t;
+
+static vlad_arena_t *arena;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+
+// The arena's lock is held across fork(), so that the child never starts
+// with it held by a thread that wasn't copied along with it
+
+static void fork_prepare(void)
+{
+    vlad_arena_lock(arena);
+}
+
+static void fork_release(void)
+{
+    vlad_arena_unlock(arena);
+}
+
+static void arena_create(void)
+{
+    arena = vlad_arena_create_growable(CHUNK_SIZE, MAX_SIZE);
+    if (arena)
+        pthread_atfork(fork_prepare, fork_release, fork_release);
+}
+
+static vlad_arena_t *get_arena(void)
+{
+    pthread_once(&arena_once, arena_create);
+    return arena;
+}
+
+// Maps in n bytes aligned to `alignment`, with a big_header_t in front
+static void *big_alloc(size_t n, size_t alignment)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (alignment < MIN_ALIGN)
+        alignment = MIN_ALIGN;
+    if (n > SIZE_MAX - alignment - sizeof(big_header_t) - page) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    size_t size = (sizeof(big_header_t) + alignment + n + page - 1) & ~(page - 1);
+    char *start = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (start == MAP_FAILED) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    uintptr_t object = ((uintptr_t)start + sizeof(big_header_t) + alignment - 1) & ~(alignment - 1);
+    big_header_t *header = (big_header_t *)object - 1;
+    header->map_size = size;
+    header->offset = object - (uintptr_t)start;
+    return (void *)object;
+}
+
+static void big_free(void *object)
+{
+    big_header_t *header = (big_header_t *)object - 1;
+    munmap((char *)object - header->offset, header->map_size);
+}
+
+static size_t big_usable_size(void *object)
+{
+    big_header_t *header = (big_header_t *)object - 1;
+    return header->map_size - header->offset;
+}
+
+void *malloc(size_t n)
+{
+    void *object = NULL;
+    if (n <= BIG_SIZE)
+        object = vlad_arena_malloc(get_arena(), n);
+    if (!object)
+        object = big_alloc(n, MIN_ALIGN);
+    return object;
+}
+
+void free(void *object)
+{
+    if (!object)
+        return;
+    if (vlad_arena_contains(get_arena(), object))
+        vlad_arena_free(arena, object);
+    else
+        big_free(object);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    size_t n;
+    if (__builtin_mul_overflow(count, size, &n)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void *object = NULL;
+    if (n <= BIG_SIZE)
+        object = vlad_arena_calloc(get_arena(), n, 1);
+    if (!object)
+        object = big_alloc(n, MIN_ALIGN); // Fresh mappings are already zeroed
+    return object;
+}
+
+size_t malloc_usable_size(void *object)
+{
+    if (!object)
+        return 0;
+    if (vlad_arena_contains(get_arena(), object))
+        return vlad_arena_usable_size(arena, object);
+    return big_usable_size(object);
+}
+
+void *realloc(void *object, size_t n)
+{
+    if (!object)
+        return malloc(n);
+    if (!n) {
+        free(object);
+        return NULL;
+    }
+
+    size_t oldSize;
+    if (vlad_arena_contains(get_arena(), object)) {
+        if (n <= BIG_SIZE) {
+            void *newObject = vlad_arena_realloc(arena, object, n);
+            if (newObject)
+                return newObject;
+        }
+        oldSize = vlad_arena_usable_size(arena, object);
+    } else {
+        // Let the kernel move the pages of a big object if it has to, unless
+        // it was aligned beyond the usual
+        big_header_t *header = (big_header_t *)object - 1;
+        if (n > BIG_SIZE && header->offset == MIN_ALIGN &&
+            n <= SIZE_MAX - MIN_ALIGN - sysconf(_SC_PAGESIZE)) {
+            size_t page = sysconf(_SC_PAGESIZE);
+            size_t size = (MIN_ALIGN + n + page - 1) & ~(page - 1);
+            char *start = mremap((char *)header, header->map_size, size, MREMAP_MAYMOVE);
+            if (start == MAP_FAILED) {
+                errno = ENOMEM;
+                return NULL;
+            }
+
+            header = (big_header_t *)start;
+            header->map_size = size;
+            return header + 1;
+        }
+        oldSize = big_usable_size(object);
+    }
+
+    void *newObject = malloc(n);
+    if (newObject) {
+        memcpy(newObject, object, oldSize < n ? oldSize : n);
+        free(object);
+    }
+    return newObject;
+}
+
+static void *aligned_alloc_any(size_t alignment, size_t n)
+{
+    void *object = NULL;
+    if (n <= BIG_SIZE && alignment <= BIG_SIZE)
+        object = vlad_arena_memalign(get_arena(), alignment, n);
+    if (!object)
+        object = big_alloc(n, alignment);
+    return object;
+}
+
+int posix_memalign(void **out, size_t alignment, size_t n)
+{
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)))
+        return EINVAL;
+
+    void *object = aligned_alloc_any(alignment, n);
+    if (!object)
+        return ENOMEM;
+    *out = object;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t n)
+{
+    if (!alignment || (alignment & (alignment - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return aligned_alloc_any(alignment, n);
+}
+
+void *memalign(size_t alignment, size_t n)
+{
+    return aligned_alloc(alignment, n);
+}
+
+void *valloc(size_t n)
+{
+    return aligned_alloc_any(sysconf(_SC_PAGESIZE), n);
+}
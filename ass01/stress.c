@@ -0,0 +1,100 @@
+//
+// COMP1927 Assignment 1 - Memory allocator stress test
+// stress.c ... hammer the allocator from several threads at once
+//
+// Usage: ./stress [allocations per thread]
+//
+// Each thread keeps SLOTS live objects and keeps replacing a random one with
+// a new allocation, mostly of small sizes with the occasional large one.
+// The allocator must be built with VLAD_THREADS.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "allocator.h"
+
+#define MEMORY_SIZE (1 << 26)
+#define SLOTS 1024
+#define DEFAULT_ALLOCS 1000000
+
+typedef struct worker {
+    pthread_t thread;
+    u_int32_t seed;
+    long allocs;   // # allocations to do
+    long failures; // # allocations that returned NULL
+} worker_t;
+
+static inline u_int32_t xorshift(u_int32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void *work(void *arg)
+{
+    worker_t *w = arg;
+    char *slots[SLOTS] = {NULL};
+
+    for (long i = 0; i < w->allocs; ++i) {
+        u_int32_t r = xorshift(&w->seed);
+        u_int32_t slot = r % SLOTS;
+        if (slots[slot])
+            vlad_free(slots[slot]);
+
+        u_int32_t size = (r >> 10) % 16 ? (r >> 14) % 256 + 1 : (r >> 14) % 8192 + 1;
+        slots[slot] = vlad_malloc(size);
+        if (slots[slot])
+            slots[slot][0] = (char)slot;
+        else
+            ++w->failures;
+    }
+
+    for (u_int32_t slot = 0; slot < SLOTS; ++slot)
+        if (slots[slot])
+            vlad_free(slots[slot]);
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    long allocs = argc > 1 ? atol(argv[1]) : DEFAULT_ALLOCS;
+    worker_t workers[8];
+
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        vlad_init(MEMORY_SIZE);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int i = 0; i < threads; ++i) {
+            workers[i].seed = 2463534242u + i;
+            workers[i].allocs = allocs;
+            workers[i].failures = 0;
+            if (pthread_create(&workers[i].thread, NULL, work, &workers[i])) {
+                fprintf(stderr, "Cannot create thread\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        long failures = 0;
+        for (int i = 0; i < threads; ++i) {
+            pthread_join(workers[i].thread, NULL);
+            failures += workers[i].failures;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        printf("%d thread%s:\t%.0f allocs/sec\t(%ld failed)\n",
+            threads, threads == 1 ? " " : "s", threads * allocs / seconds, failures);
+
+        vlad_end();
+    }
+
+    return EXIT_SUCCESS;
+}
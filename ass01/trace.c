@@ -0,0 +1,245 @@
+//
+//  COMP1927 Assignment 1 - Vlad: the memory allocator
+//  trace.c ... recording and reading allocation traces
+//
+
+#include "trace.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_BUFFER_SIZE (1 << 20)
+#define MIN_TABLE_SIZE    (1 << 10)
+
+// A live object, in an open-addressed (linear probing) hash table keyed by
+// its address
+typedef struct live_object {
+    void *object; // NULL if this entry is empty
+    u_int32_t id;
+} live_object_t;
+
+static FILE *trace_file;
+
+static live_object_t *live_objects;
+static size_t table_size; // a power of two
+static size_t num_live;
+
+static u_int32_t *free_ids; // ids whose objects have been freed
+static size_t num_free_ids;
+static size_t free_ids_capacity;
+static u_int32_t num_ids;   // ids handed out so far
+
+static void out_of_memory(void)
+{
+    fprintf(stderr, "vlad_trace: insufficient memory");
+    abort();
+}
+
+static inline size_t hash(void *object)
+{
+    // Objects are at least 16 byte aligned, so the low bits say little
+    uintptr_t key = (uintptr_t)object >> 4;
+    return (key * 0x9E3779B97F4A7C15ull) >> 17;
+}
+
+static void write_record(u_int32_t op, u_int32_t id, u_int32_t size)
+{
+    trace_record_t record = {op, id, size};
+    fwrite(&record, sizeof(record), 1, trace_file);
+}
+
+static void table_insert(void *object, u_int32_t id)
+{
+    size_t i = hash(object) & (table_size - 1);
+    while (live_objects[i].object)
+        i = (i + 1) & (table_size - 1);
+
+    live_objects[i].object = object;
+    live_objects[i].id = id;
+}
+
+static void table_grow(void)
+{
+    live_object_t *oldObjects = live_objects;
+    size_t oldSize = table_size;
+
+    table_size = oldSize ? oldSize * 2 : MIN_TABLE_SIZE;
+    live_objects = calloc(table_size, sizeof(live_object_t));
+    if (!live_objects)
+        out_of_memory();
+
+    for (size_t i = 0; i < oldSize; ++i)
+        if (oldObjects[i].object)
+            table_insert(oldObjects[i].object, oldObjects[i].id);
+    free(oldObjects);
+}
+
+// Removes object from the table and returns its id, shifting later entries
+// of the same probe sequence back so that no tombstones are needed
+
+static u_int32_t table_remove(void *object)
+{
+    size_t i = hash(object) & (table_size - 1);
+    while (live_objects[i].object != object) {
+        if (!live_objects[i].object) {
+            fprintf(stderr, "vlad_trace: free of untraced object %p", object);
+            abort();
+        }
+        i = (i + 1) & (table_size - 1);
+    }
+    u_int32_t id = live_objects[i].id;
+
+    size_t hole = i;
+    while (true) {
+        i = (i + 1) & (table_size - 1);
+        if (!live_objects[i].object)
+            break;
+
+        // Entries whose home slot lies cyclically in (hole, i] must stay put
+        size_t home = hash(live_objects[i].object) & (table_size - 1);
+        if (((i - home) & (table_size - 1)) < ((i - hole) & (table_size - 1)))
+            continue;
+
+        live_objects[hole] = live_objects[i];
+        hole = i;
+    }
+    live_objects[hole].object = NULL;
+
+    --num_live;
+    return id;
+}
+
+static void on_malloc(void *object, u_int32_t n)
+{
+    if (2 * (num_live + 1) > table_size)
+        table_grow();
+
+    u_int32_t id = num_free_ids ? free_ids[--num_free_ids] : num_ids++;
+    table_insert(object, id);
+    ++num_live;
+
+    write_record(TRACE_MALLOC, id, n);
+}
+
+static void on_free(void *object)
+{
+    u_int32_t id = table_remove(object);
+
+    if (num_free_ids == free_ids_capacity) {
+        free_ids_capacity *= 2;
+        free_ids = realloc(free_ids, free_ids_capacity * sizeof(u_int32_t));
+        if (!free_ids)
+            out_of_memory();
+    }
+    free_ids[num_free_ids++] = id;
+
+    write_record(TRACE_FREE, id, 0);
+}
+
+static void on_realloc(void *oldObject, void *newObject, u_int32_t n)
+{
+    u_int32_t id = table_remove(oldObject);
+    table_insert(newObject, id);
+    ++num_live;
+
+    write_record(TRACE_REALLOC, id, n);
+}
+
+static const vlad_hooks_t trace_hooks = {on_malloc, on_free, on_realloc};
+
+// Input: path - file to write the trace to
+// Output: ok - whether recording has started
+// Precondition: not already recording, and only one thread uses vlad
+// Postcondition: every vlad_malloc() and friends on the default arena is
+//                recorded until vlad_trace_stop()
+
+bool vlad_trace_start(const char *path)
+{
+    trace_file = fopen(path, "wb");
+    if (!trace_file)
+        return false;
+    setvbuf(trace_file, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), trace_file);
+
+    table_size = 0;
+    num_live = 0;
+    table_grow();
+
+    free_ids_capacity = MIN_TABLE_SIZE;
+    free_ids = malloc(free_ids_capacity * sizeof(u_int32_t));
+    if (!free_ids)
+        out_of_memory();
+    num_free_ids = 0;
+    num_ids = 0;
+
+    vlad_set_hooks(&trace_hooks);
+    return true;
+}
+
+// Precondition: none
+// Postcondition: the trace file is complete and closed
+
+void vlad_trace_stop(void)
+{
+    if (!trace_file)
+        return;
+
+    vlad_set_hooks(NULL);
+    fclose(trace_file);
+    trace_file = NULL;
+
+    free(live_objects);
+    free(free_ids);
+    live_objects = NULL;
+    free_ids = NULL;
+}
+
+// Input: path - trace file to read
+// Output: records - all of the records in the file, or NULL on error
+//         *count - # of records
+//         *numIds - all ids in the trace are < *numIds
+// Precondition: none
+// Postcondition: the caller must free(records)
+
+trace_record_t *trace_read(const char *path, size_t *count, u_int32_t *numIds)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+        return NULL;
+
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+            memcmp(magic, TRACE_MAGIC, sizeof(magic))) {
+        fclose(in);
+        return NULL;
+    }
+
+    size_t capacity = 1 << 16;
+    trace_record_t *records = malloc(capacity * sizeof(trace_record_t));
+    *count = 0;
+    *numIds = 0;
+    while (records) {
+        *count += fread(records + *count, sizeof(trace_record_t), capacity - *count, in);
+        if (*count < capacity)
+            break;
+
+        capacity *= 2;
+        trace_record_t *newRecords = realloc(records, capacity * sizeof(trace_record_t));
+        if (!newRecords)
+            free(records);
+        records = newRecords;
+    }
+    fclose(in);
+
+    for (size_t i = 0; records && i < *count; ++i) {
+        if (records[i].op > TRACE_FREE) {
+            free(records);
+            return NULL;
+        }
+        if (records[i].id >= *numIds)
+            *numIds = records[i].id + 1;
+    }
+
+    return records;
+}
@@ -0,0 +1,57 @@
+//
+//  COMP1927 Assignment 1 - Vlad: the memory allocator
+//  trace.h ... recording and reading allocation traces
+//
+//  A trace file starts with TRACE_MAGIC, followed by trace_record_t's in
+//  native byte order, one for every vlad_malloc() (or vlad_calloc()),
+//  vlad_realloc() and vlad_free() that the traced program made.
+//  Objects are identified by small integer ids rather than addresses, and an
+//  id is reused once its object is freed, so a replayer only needs an array
+//  as big as the most objects that were ever live at once.
+//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "allocator.h"
+
+#define TRACE_MAGIC "VLADTRC1"
+
+enum trace_op {
+    TRACE_MALLOC,
+    TRACE_REALLOC,
+    TRACE_FREE
+};
+
+typedef struct trace_record {
+    u_int32_t op;   // an enum trace_op
+    u_int32_t id;   // which object
+    u_int32_t size; // # bytes requested (0 for TRACE_FREE)
+} trace_record_t;
+
+// Input: path - file to write the trace to
+// Output: ok - whether recording has started
+// Precondition: not already recording, and only one thread uses vlad
+// Postcondition: every vlad_malloc() and friends on the default arena is
+//                recorded until vlad_trace_stop()
+
+bool vlad_trace_start(const char *path);
+
+// Precondition: none
+// Postcondition: the trace file is complete and closed
+
+void vlad_trace_stop(void);
+
+// Input: path - trace file to read
+// Output: records - all of the records in the file, or NULL on error
+//         *count - # of records
+//         *numIds - all ids in the trace are < *numIds
+// Precondition: none
+// Postcondition: the caller must free(records)
+
+trace_record_t *trace_read(const char *path, size_t *count, u_int32_t *numIds);
+
+#endif
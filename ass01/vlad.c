@@ -10,6 +10,7 @@
 #include <unistd.h>
 
 #include "allocator.h"
+#include "trace.h"
 
 #define MEMORY_SIZE 4096
 
@@ -21,6 +22,7 @@ typedef unsigned char Byte;
 // Possible commands:
 //    + X N  ... allocate N bytes and assign to X
 //    - X    ... free memory associated with X
+//    ~ X N  ... resize memory associated with X to N bytes
 //    * X N  ... store N in memory referenced by X
 //    !      ... show sal statistics
 //    ?      ... show this help message
@@ -47,8 +49,10 @@ int main(int argc, char *argv[])
       ptr[i-'a'] = NULL;
    }
 
-   // start the allocator
+   // start the allocator, recording what we do with it if asked
    vlad_init(MEMORY_SIZE);
+   if (getenv("VLAD_TRACE") && !vlad_trace_start(getenv("VLAD_TRACE")))
+      perror(getenv("VLAD_TRACE"));
 
    // main loop ... read command and carry it out
    if (isatty(0) && !quiet) printf("> ");
@@ -81,6 +85,20 @@ int main(int argc, char *argv[])
             ptr[var-'a'] = NULL;
          }
       }
+      else if (sscanf(line, "~ %[a-z] %d", &var, &val) == 2) {
+         // resize memory allocated by sal, possibly moving it
+         if (ptr[var-'a'] == NULL)
+            fprintf(stderr, "Attempt to resize null pointer\n");
+         else {
+            Byte *b = vlad_realloc(ptr[var-'a'], val);
+            if (b == NULL && val != 0)
+               fprintf(stderr, "Failed to resize ptr[%c] to %d bytes\n", var, val);
+            else {
+               ptr[var-'a'] = b;
+               if (!quiet) printf("ptr[%c] resized to %p\n", var, b);
+            }
+         }
+      }
       else if (sscanf(line, "* %[a-z] %d", &var, &val) == 2) {
          // write something into an allocated piece of memory
          if (ptr[var-'a'] == NULL)
@@ -95,6 +113,7 @@ int main(int argc, char *argv[])
          printf("Possible commands:\n");
          printf("+ X N  ... allocate N bytes and assign to X\n");
          printf("- X    ... free memory associated with X\n");
+         printf("~ X N  ... resize memory associated with X to N bytes\n");
          printf("* X N  ... store N in memory referenced by X\n");
          printf("!      ... show sal statistics\n");
          printf("?      ... show this help message\n");
@@ -117,6 +136,7 @@ int main(int argc, char *argv[])
       if (isatty(0) && !quiet) printf("> ");
    }
 
+   vlad_trace_stop();
    vlad_end();
 
    return EXIT_SUCCESS;
@@ -5,6 +5,10 @@
 #include <stdio.h>
 #include <assert.h>
 #include "IntList.h"
+#include "IntListSort.h"
+#include "IntListIO.h"
+
+#define MAX_RUNS 32 // enough merge sort runs for 2^32 values
 
 // data structures representing IntList
 
@@ -59,10 +63,12 @@ void showIntList(IntList L)
 IntList getIntList(FILE *inf)
 {
 	IntList L;
+	IntReader r;
 	int v;
 
 	L = newIntList();
-	while (fscanf(inf,"%d",&v) != EOF)
+	startReading(&r, inf);
+	while (readInt(&r, &v))
 		IntListInsert(L,v);
 	return L;
 }
@@ -175,18 +181,185 @@ IntList IntListCopy(IntList L)
 	return Lnew;
 }
 
+// merge two sorted chains of nodes into one
+// on ties, nodes from a go first, which keeps the sort stable
+// (this function is local to this ADT)
+static struct IntListNode *mergeNodes(struct IntListNode *a,
+                                      struct IntListNode *b)
+{
+	struct IntListNode head, *tail = &head;
+
+	while (a != NULL && b != NULL) {
+		if (b->data < a->data) {
+			tail->next = b;
+			b = b->next;
+		} else {
+			tail->next = a;
+			a = a->next;
+		}
+		tail = tail->next;
+	}
+	tail->next = (a != NULL) ? a : b;
+	return head.next;
+}
+
+// bottom-up merge sort of a chain of nodes
+// runs[i] holds a sorted run of 2^i nodes, or nothing; each node is
+// added like carrying in a binary counter, merging equal-sized runs
+// (this function is local to this ADT)
+static struct IntListNode *mergeSortNodes(struct IntListNode *nodes)
+{
+	struct IntListNode *runs[MAX_RUNS] = { NULL };
+	struct IntListNode *run;
+	int i;
+
+	while (nodes != NULL) {
+		run = nodes;
+		nodes = nodes->next;
+		run->next = NULL;
+		// runs[] hold nodes from before run, so they go first
+		for (i = 0; runs[i] != NULL; i++) {
+			run = mergeNodes(runs[i], run);
+			runs[i] = NULL;
+		}
+		runs[i] = run;
+	}
+
+	run = NULL;
+	for (i = 0; i < MAX_RUNS; i++) {
+		if (runs[i] != NULL)
+			run = mergeNodes(runs[i], run);
+	}
+	return run;
+}
+
+// sort a chain of nodes, with values in [min..max], with a counting
+// sort: count how many of each value there are, then write them back
+// into the nodes in order
+// (this function is local to this ADT)
+static void countingSortNodes(struct IntListNode *nodes, int min, int max)
+{
+	struct IntListNode *curr;
+	int *counts;
+	int i;
+
+	counts = calloc((unsigned)max - (unsigned)min + 1, sizeof (int));
+	assert(counts != NULL);
+	for (curr = nodes; curr != NULL; curr = curr->next)
+		counts[(unsigned)curr->data - (unsigned)min]++;
+	for (i = 0, curr = nodes; curr != NULL; i++) {
+		int count = counts[i];
+		for (; count > 0; count--, curr = curr->next)
+			curr->data = (int)((unsigned)min + i);
+	}
+	free(counts);
+}
+
+// copy the values in a list into a new array
+// (this function is local to this ADT)
+static int *listValues(IntList L)
+{
+	struct IntListNode *curr;
+	int *values;
+	int i;
+
+	values = malloc(L->size * sizeof (int));
+	assert(L->size == 0 || values != NULL);
+	for (i = 0, curr = L->first; curr != NULL; i++, curr = curr->next)
+		values[i] = curr->data;
+	return values;
+}
+
+// sort a list into ascending order, in place
+// O(n + range) counting sort if the range of its values is small next
+// to its length, else a radix sort if that needs few enough passes,
+// else an O(n log n) merge sort; long lists are split between threads,
+// and equal values keep their order either way
+void IntListSort(IntList L)
+{
+	struct IntListNode *curr;
+	int *values;
+	int min, max, sorted, i;
+
+	assert(L != NULL);
+	if (L->size < 2)
+		return;
+
+	// one pass to find the range, and whether there's anything to do
+	min = max = L->first->data;
+	sorted = 1;
+	for (curr = L->first; curr->next != NULL; curr = curr->next) {
+		int v = curr->next->data;
+		if (v < curr->data) sorted = 0;
+		if (v < min) min = v;
+		if (v > max) max = v;
+	}
+	if (sorted)
+		return;
+
+	if (countingSortFits(L->size, min, max)) {
+		countingSortNodes(L->first, min, max);
+		return;
+	}
+
+	// merge sorting the nodes themselves saves copying the values out,
+	// unless a radix sort or more threads would be quicker
+	if (sortThreads(L->size) == 1 && radixPasses(L->size, min, max) == 0) {
+		L->first = mergeSortNodes(L->first);
+		for (L->last = L->first; L->last->next != NULL; L->last = L->last->next)
+			;
+		return;
+	}
+
+	// the nodes stay put, and the sorted values are written back into
+	// them (equal ints being indistinguishable, this is still stable)
+	values = listValues(L);
+	sortInts(values, L->size, min, max);
+	for (i = 0, curr = L->first; curr != NULL; i++, curr = curr->next)
+		curr->data = values[i];
+	free(values);
+}
+
 // make a sorted physical copy of a list
 IntList IntListSortedCopy(IntList L)
 {
-	struct IntListRep *Lnew;
-	struct IntListNode *curr;
+	IntList Lnew;
+
+	Lnew = IntListCopy(L);
+	IntListSort(Lnew);
+	return Lnew;
+}
+
+// make a sorted list of the distinct values in a list
+IntList IntListUniqueSorted(IntList L)
+{
+	IntList Lnew;
+	IntCount *counts;
+	int n, i;
 
+	counts = IntListHistogram(L, &n);
 	Lnew = newIntList();
-	for (curr = L->first; curr != NULL; curr = curr->next)
-		IntListInsertInOrder(Lnew, curr->data);
+	for (i = 0; i < n; i++)
+		IntListInsert(Lnew, counts[i].value);
+	free(counts);
 	return Lnew;
 }
 
+// count how many times each distinct value occurs in a list
+// returns an array of the counts, in ascending order of value, and
+// sets *n to its length; the caller frees it (NULL if list is empty)
+IntCount *IntListHistogram(IntList L, int *n)
+{
+	IntCount *counts;
+	int *values;
+
+	assert(L != NULL);
+	values = listValues(L);
+	counts = countInts(values, L->size, n);
+	free(values);
+	return counts;
+}
+
 // check whether a list is sorted in ascending order
 // returns 0 if list is not sorted, returns non-zero if it is
 int IntListIsSorted(IntList L)
@@ -230,8 +403,11 @@ int IntListOK(IntList L)
 void IntListPrint(FILE *outf, IntList L)
 {
 	struct IntListNode *curr;
+	IntWriter w;
 
 	assert(L != NULL);
+	startWriting(&w, outf);
 	for (curr = L->first; curr != NULL; curr = curr->next)
-		fprintf(outf, "%d\n", curr->data);
+		writeInt(&w, curr->data);
+	finishWriting(&w);
 }
@@ -7,10 +7,17 @@
 #include <stdio.h>
 
 // External view of IntList
-// Implementation given in intList.c
+// Implementations given in IntList.c (a node per value)
+// and IntListArray.c (a growable array of values)
 
 typedef struct IntListRep *IntList;
 
+// how many times a value occurs in a list
+typedef struct IntCount {
+	int value;
+	int count;
+} IntCount;
+
 // create a new empty IntList
 IntList newIntList();
 
@@ -41,9 +48,28 @@ int IntListLength(IntList);
 // new list looks identical to original list
 IntList IntListCopy(IntList);
 
+// sort a list into ascending order, in place
+// O(n + range) counting sort if the range of its values is small next
+// to its length, else a radix sort if that needs few enough passes,
+// else an O(n log n) merge sort; long lists are split between threads,
+// and equal values keep their order either way
+void IntListSort(IntList);
+
 // make a sorted physical copy of a list
 IntList IntListSortedCopy(IntList);
 
+// make a sorted list of the distinct values in a list
+IntList IntListUniqueSorted(IntList);
+
+// count how many times each distinct value occurs in a list
+// returns an array of the counts, in ascending order of value, and
+// sets *n to its length; the caller frees it (NULL if list is empty)
+IntCount *IntListHistogram(IntList, int *n);
+
+// set how many threads long lists are sorted with
+// 0 (the default) means one per online CPU; short lists always use one
+void IntListSetSortThreads(int);
+
 // check whether a list is sorted in ascending order
 // returns 0 if list is not sorted, returns non-zero if it is
 int IntListIsSorted(IntList);
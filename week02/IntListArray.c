@@ -0,0 +1,281 @@
+// IntListArray.c - Lists of integers, stored in a growable array
+// Same interface as IntList.c, but with all of the values kept next
+// to each other in one block of memory, rather than in a node each
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "IntList.h"
+#include "IntListSort.h"
+#include "IntListIO.h"
+
+#define MIN_CAPACITY 16
+#define READ_BATCH 1024 // values read at a time by getIntList()
+
+// data structures representing IntList
+
+struct IntListRep {
+	int  size;      // number of elements in list
+	int  capacity;  // number of elements there is room for
+	int *values;    // values[0..size-1] hold the list, in order
+};
+
+// create a new empty IntList
+IntList newIntList()
+{
+	struct IntListRep *L;
+
+	L = malloc(sizeof (struct IntListRep));
+	assert (L != NULL);
+	L->size = 0;
+	L->capacity = 0;
+	L->values = NULL;
+	return L;
+}
+
+// free up all space associated with list
+void freeIntList(IntList L)
+{
+	free(L->values);
+	free(L);
+}
+
+// display list as one integer per line on stdout
+void showIntList(IntList L)
+{
+	IntListPrint(stdout, L);
+}
+
+// make sure there is room for at least n values
+// grows geometrically, so n appends cost O(n) altogether
+// (this function is local to this ADT)
+static void reserve(IntList L, int n)
+{
+	int capacity;
+
+	if (n <= L->capacity)
+		return;
+	capacity = L->capacity < MIN_CAPACITY ? MIN_CAPACITY : L->capacity;
+	while (capacity < n)
+		capacity *= 2;
+	L->values = realloc(L->values, capacity * sizeof (int));
+	assert(L->values != NULL);
+	L->capacity = capacity;
+}
+
+// append n values to the end of a list, making room for them once
+// (this function is local to this ADT)
+static void appendInts(IntList L, const int *v, int n)
+{
+	if (n == 0)
+		return;
+	reserve(L, L->size + n);
+	memcpy(&L->values[L->size], v, n * sizeof (int));
+	L->size += n;
+}
+
+// create an IntList by reading values from a file
+// assume that the file is open for reading
+// values are read into a batch, which is appended to the list in one go
+IntList getIntList(FILE *inf)
+{
+	IntList L;
+	IntReader r;
+	int batch[READ_BATCH];
+	int n;
+
+	L = newIntList();
+	startReading(&r, inf);
+	do {
+		for (n = 0; n < READ_BATCH && readInt(&r, &batch[n]); n++)
+			;
+		appendInts(L, batch, n);
+	} while (n == READ_BATCH);
+	return L;
+}
+
+// apppend one integer to the end of a list
+void IntListInsert(IntList L, int v)
+{
+	assert(L != NULL);
+	reserve(L, L->size + 1);
+	L->values[L->size++] = v;
+}
+
+// insert an integer into correct place in a sorted list
+// finds the place by binary search, then moves everything after it
+// up by one in a single memmove()
+void IntListInsertInOrder(IntList L, int v)
+{
+	int lo, hi;
+
+	assert(L != NULL);
+	reserve(L, L->size + 1);
+
+	// largest value case (including the empty list)
+	if (L->size == 0 || v >= L->values[L->size - 1]) {
+		L->values[L->size++] = v;
+		return;
+	}
+
+	// find the first value >= v
+	lo = 0; hi = L->size - 1;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (L->values[mid] < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	memmove(&L->values[lo + 1], &L->values[lo],
+	        (L->size - lo) * sizeof (int));
+	L->values[lo] = v;
+	L->size++;
+}
+
+// delete first occurrence of v from a list
+// if v does not occur in List, no effect
+void IntListDelete(IntList L, int v)
+{
+	int i;
+
+	assert(L != NULL);
+
+	// find where v occurs in list
+	for (i = 0; i < L->size && L->values[i] != v; i++)
+		;
+	// not found; give up
+	if (i == L->size) return;
+	// close the gap
+	memmove(&L->values[i], &L->values[i + 1],
+	        (L->size - i - 1) * sizeof (int));
+	L->size--;
+}
+
+// return number of elements in a list
+int IntListLength(IntList L)
+{
+	assert(L != NULL);
+	return L->size;
+}
+
+// make a physical copy of a list
+// new list looks identical to original list
+IntList IntListCopy(IntList L)
+{
+	struct IntListRep *Lnew;
+
+	assert(L != NULL);
+	Lnew = newIntList();
+	reserve(Lnew, L->size);
+	if (L->size > 0)
+		memcpy(Lnew->values, L->values, L->size * sizeof (int));
+	Lnew->size = L->size;
+	return Lnew;
+}
+
+// sort a list into ascending order, in place
+// O(n + range) counting sort if the range of its values is small next
+// to its length, else a radix sort if that needs few enough passes,
+// else an O(n log n) merge sort; long lists are split between threads,
+// and equal values keep their order either way
+void IntListSort(IntList L)
+{
+	int min, max, sorted, i;
+
+	assert(L != NULL);
+	if (L->size < 2)
+		return;
+
+	// one pass to find the range, and whether there's anything to do
+	min = max = L->values[0];
+	sorted = 1;
+	for (i = 1; i < L->size; i++) {
+		int v = L->values[i];
+		if (v < L->values[i - 1]) sorted = 0;
+		if (v < min) min = v;
+		if (v > max) max = v;
+	}
+	if (sorted)
+		return;
+
+	sortInts(L->values, L->size, min, max);
+}
+
+// make a sorted physical copy of a list
+IntList IntListSortedCopy(IntList L)
+{
+	IntList Lnew;
+
+	Lnew = IntListCopy(L);
+	IntListSort(Lnew);
+	return Lnew;
+}
+
+// make a sorted list of the distinct values in a list
+IntList IntListUniqueSorted(IntList L)
+{
+	IntList Lnew;
+	IntCount *counts;
+	int n, i;
+
+	counts = IntListHistogram(L, &n);
+	Lnew = newIntList();
+	reserve(Lnew, n);
+	for (i = 0; i < n; i++)
+		Lnew->values[i] = counts[i].value;
+	Lnew->size = n;
+	free(counts);
+	return Lnew;
+}
+
+// count how many times each distinct value occurs in a list
+// returns an array of the counts, in ascending order of value, and
+// sets *n to its length; the caller frees it (NULL if list is empty)
+IntCount *IntListHistogram(IntList L, int *n)
+{
+	assert(L != NULL);
+	return countInts(L->values, L->size, n);
+}
+
+// check whether a list is sorted in ascending order
+// returns 0 if list is not sorted, returns non-zero if it is
+int IntListIsSorted(IntList L)
+{
+	int i;
+
+	assert(L != NULL);
+	// scan list, looking for out-of-order pair
+	for (i = 1; i < L->size; i++) {
+		if (L->values[i] < L->values[i - 1])
+			return 0;
+	}
+	// nothing out-of-order, must be sorted
+	return 1;
+}
+
+// check sanity of an IntList (for debugging)
+int IntListOK(IntList L)
+{
+	if (L == NULL)
+		return 1;
+	if (L->capacity == 0)
+		return (L->size == 0 && L->values == NULL);
+
+	return (L->size >= 0 && L->size <= L->capacity && L->values != NULL);
+}
+
+// display list as one integer per line to a file
+// assume that the file is open for writing
+void IntListPrint(FILE *outf, IntList L)
+{
+	IntWriter w;
+	int i;
+
+	assert(L != NULL);
+	startWriting(&w, outf);
+	for (i = 0; i < L->size; i++)
+		writeInt(&w, L->values[i]);
+	finishWriting(&w);
+}
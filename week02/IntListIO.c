@@ -0,0 +1,141 @@
+// IntListIO.c - Reading and writing integers in bulk, for the IntList
+// implementations
+// Instead of going through fscanf() and fprintf() for every value,
+// input is read 64KB at a time and scanned by hand, and output is
+// formatted by hand into a 64KB buffer and written out when it fills
+
+#include <stdio.h>
+#include <string.h>
+#include "IntListIO.h"
+
+#define MAX_INT_LEN 12  // "-2147483648\n"
+
+// same as isspace() in the C locale, but quicker
+// (this function is local to this module)
+static int isSpace(char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// start reading integers from a file
+// assume that the file is open for reading
+void startReading(IntReader *r, FILE *inf)
+{
+	r->in = inf;
+	r->pos = r->len = 0;
+	r->eof = 0;
+}
+
+// move what hasn't been looked at yet to the front of the buffer,
+// and fill up the rest from the file
+// returns the number of characters added
+// (this function is local to this module)
+static int refill(IntReader *r)
+{
+	size_t got;
+
+	if (r->eof)
+		return 0;
+	memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+	r->len -= r->pos;
+	r->pos = 0;
+	got = fread(r->buf + r->len, 1, INTIO_BUF_SIZE - r->len, r->in);
+	if (got == 0)
+		r->eof = 1;
+	r->len += got;
+	return got;
+}
+
+// character at buf[*i], refilling the buffer if *i is past its end
+// (and moving *i to match), or EOF at the end of the file
+// (this function is local to this module)
+static int peek(IntReader *r, int *i)
+{
+	if (*i == r->len) {
+		int done = *i - r->pos;
+		if (!refill(r))
+			return EOF;
+		*i = r->pos + done;
+	}
+	return (unsigned char)r->buf[*i];
+}
+
+// read the next white space separated integer into *v
+// returns 1 if there was one, or 0 at the end of the input
+// (anything that isn't an integer is taken as the end of the input)
+int readInt(IntReader *r, int *v)
+{
+	unsigned value = 0;
+	int negative = 0, digits = 0;
+	int i, c;
+
+	// skip white space
+	for (;;) {
+		while (r->pos < r->len && isSpace(r->buf[r->pos]))
+			r->pos++;
+		if (r->pos < r->len)
+			break;
+		if (!refill(r))
+			return 0;
+	}
+
+	i = r->pos;
+	c = peek(r, &i);
+	if (c == '-' || c == '+') {
+		negative = (c == '-');
+		i++;
+	}
+	// values too big for an int wrap around
+	while ((c = peek(r, &i)) >= '0' && c <= '9') {
+		value = value * 10 + (c - '0');
+		digits++;
+		i++;
+	}
+
+	if (digits == 0) {
+		// not an integer; stop here for good
+		r->pos = r->len;
+		r->eof = 1;
+		return 0;
+	}
+	r->pos = i;
+	*v = negative ? (int)-value : (int)value;
+	return 1;
+}
+
+// start writing integers to a file
+// assume that the file is open for writing
+void startWriting(IntWriter *w, FILE *outf)
+{
+	w->out = outf;
+	w->len = 0;
+}
+
+// write an integer on a line of its own
+void writeInt(IntWriter *w, int v)
+{
+	char digits[MAX_INT_LEN];
+	unsigned u = (v < 0) ? -(unsigned)v : (unsigned)v;
+	int n = 0;
+
+	if (w->len > INTIO_BUF_SIZE - MAX_INT_LEN)
+		finishWriting(w);
+
+	// digits come out backwards
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	if (v < 0)
+		w->buf[w->len++] = '-';
+	while (n > 0)
+		w->buf[w->len++] = digits[--n];
+	w->buf[w->len++] = '\n';
+}
+
+// write out whatever is still in the buffer
+void finishWriting(IntWriter *w)
+{
+	fwrite(w->buf, 1, w->len, w->out);
+	w->len = 0;
+}
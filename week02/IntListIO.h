@@ -0,0 +1,46 @@
+// IntListIO.h - Reading and writing integers in bulk, for the IntList
+// implementations (not part of the IntList interface)
+
+#ifndef INTLISTIO_H
+#define INTLISTIO_H
+
+#include <stdio.h>
+
+#define INTIO_BUF_SIZE (1 << 16)
+
+// reads integers from a file a buffer-load at a time
+typedef struct IntReader {
+	FILE *in;
+	char  buf[INTIO_BUF_SIZE];
+	int   pos;  // next character to look at
+	int   len;  // number of characters in buf
+	int   eof;  // whether the file has nothing more to give
+} IntReader;
+
+// writes integers to a file a buffer-load at a time
+typedef struct IntWriter {
+	FILE *out;
+	char  buf[INTIO_BUF_SIZE];
+	int   len;  // number of characters in buf
+} IntWriter;
+
+// start reading integers from a file
+// assume that the file is open for reading
+void startReading(IntReader *, FILE *);
+
+// read the next white space separated integer into *v
+// returns 1 if there was one, or 0 at the end of the input
+// (anything that isn't an integer is taken as the end of the input)
+int readInt(IntReader *, int *v);
+
+// start writing integers to a file
+// assume that the file is open for writing
+void startWriting(IntWriter *, FILE *);
+
+// write an integer on a line of its own
+void writeInt(IntWriter *, int);
+
+// write out whatever is still in the buffer
+void finishWriting(IntWriter *);
+
+#endif
@@ -0,0 +1,478 @@
+// IntListSort.c - Sorting arrays of integers, for the IntList
+// implementations
+// Long arrays are sorted on several threads: each sorts a chunk of the
+// array, then each merges its share of all of the sorted chunks
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "IntList.h"
+#include "IntListSort.h"
+
+#define RADIX_BITS 11      // radix sort up to 11 bits at a time
+#define RADIX_MIN_SIZE 256 // shorter lists are always merge sorted
+#define RADIX_PASS_COST 3  // a radix pass costs about 3 merge passes
+
+#define COUNT_RANGE_FACTOR 2      // counting sort if there are at most
+#define COUNT_MAX_RANGE (1 << 22) // 2 possible values per value, up to 4M
+
+#define MAX_SORT_THREADS 64
+#define PARALLEL_MIN_SIZE (1 << 17)  // shorter lists are sorted on one thread
+#define PARALLEL_MIN_CHUNK (1 << 15) // and no thread gets less than this
+
+// threads to sort with, or 0 for one per online CPU
+static int numSortThreads = 0;
+
+// number of bits needed for every value in [min..max], less min
+// (this function is local to this module)
+static int rangeBits(int min, int max)
+{
+	unsigned range = (unsigned)max - (unsigned)min;
+	int bits;
+
+	for (bits = 0; range != 0; range >>= 1)
+		bits++;
+	return bits;
+}
+
+// number of radix sort passes to sort n values in [min..max],
+// or 0 if a merge sort would be quicker
+// (radix sort is O(n) per pass, against log2(n) merge passes)
+int radixPasses(int n, int min, int max)
+{
+	int passes, logSize;
+
+	if (n < RADIX_MIN_SIZE)
+		return 0;
+	passes = (rangeBits(min, max) + RADIX_BITS - 1) / RADIX_BITS;
+	for (logSize = 0; (n >> logSize) > 1; logSize++)
+		;
+	return (passes * RADIX_PASS_COST <= logSize) ? passes : 0;
+}
+
+// sort values[0..n-1] into ascending order, all of which are in
+// [min..max], using the given number of radix sort passes
+// LSD radix sort on (value - min), counting how many of each digit
+// there are, then moving each value straight to its place
+void radixSortInts(int *values, int n, int min, int max, int passes)
+{
+	int counts[1 << RADIX_BITS];
+	int *from, *to, *tmp;
+	int bits, digits, pass, i;
+
+	bits = (rangeBits(min, max) + passes - 1) / passes;
+	assert(bits <= RADIX_BITS);
+	digits = 1 << bits;
+
+	tmp = malloc(n * sizeof (int));
+	assert(tmp != NULL);
+	from = values;
+	to = tmp;
+	for (pass = 0; pass < passes; pass++) {
+		int shift = bits * pass, start = 0;
+
+		memset(counts, 0, digits * sizeof (int));
+		for (i = 0; i < n; i++)
+			counts[((unsigned)from[i] - (unsigned)min) >> shift
+			       & (digits - 1)]++;
+		// turn the counts into where each digit starts
+		for (i = 0; i < digits; i++) {
+			int count = counts[i];
+			counts[i] = start;
+			start += count;
+		}
+		for (i = 0; i < n; i++)
+			to[counts[((unsigned)from[i] - (unsigned)min) >> shift
+			          & (digits - 1)]++] = from[i];
+
+		tmp = from; from = to; to = tmp;
+	}
+
+	if (from != values) {
+		memcpy(values, from, n * sizeof (int));
+		free(from);
+	} else {
+		free(to);
+	}
+}
+
+// sort values[0..n-1] into ascending order, with a merge sort
+// bottom-up: merges runs of 1, then 2, then 4 ... values, back and
+// forth between values[] and a second array
+void mergeSortInts(int *values, int n)
+{
+	int *from, *to, *tmp;
+	int width, lo;
+
+	tmp = malloc(n * sizeof (int));
+	assert(n == 0 || tmp != NULL);
+	from = values;
+	to = tmp;
+	for (width = 1; width < n; width *= 2) {
+		for (lo = 0; lo < n; lo += 2 * width) {
+			int mid = (lo + width < n) ? lo + width : n;
+			int hi = (mid + width < n) ? mid + width : n;
+			int a = lo, b = mid, k = lo;
+
+			// on ties, the earlier run goes first
+			while (a < mid && b < hi)
+				to[k++] = (from[b] < from[a]) ? from[b++] : from[a++];
+			while (a < mid)
+				to[k++] = from[a++];
+			while (b < hi)
+				to[k++] = from[b++];
+		}
+		tmp = from; from = to; to = tmp;
+	}
+
+	if (from != values) {
+		memcpy(values, from, n * sizeof (int));
+		free(from);
+	} else {
+		free(to);
+	}
+}
+
+// whether [min..max] is small enough, compared to n, for a counting
+// sort of n values in it to be quickest
+int countingSortFits(int n, int min, int max)
+{
+	unsigned range = (unsigned)max - (unsigned)min;
+
+	return range < COUNT_MAX_RANGE && range < (unsigned)n * COUNT_RANGE_FACTOR;
+}
+
+// sort values[0..n-1] into ascending order, all of which are in
+// [min..max], with a counting sort
+// counts how many of each value there are, then writes them out in
+// order (equal ints being indistinguishable, this is stable)
+void countingSortInts(int *values, int n, int min, int max)
+{
+	int *counts;
+	int i, k;
+
+	counts = calloc((unsigned)max - (unsigned)min + 1, sizeof (int));
+	assert(counts != NULL);
+	for (i = 0; i < n; i++)
+		counts[(unsigned)values[i] - (unsigned)min]++;
+	for (i = 0, k = 0; k < n; i++) {
+		int count = counts[i];
+		while (count-- > 0)
+			values[k++] = (int)((unsigned)min + i);
+	}
+	free(counts);
+}
+
+// sort values[0..n-1] into ascending order, all of which are in
+// [min..max], on this thread
+// (this function is local to this module)
+static void sortIntsHere(int *values, int n, int min, int max)
+{
+	int passes = radixPasses(n, min, max);
+
+	if (countingSortFits(n, min, max))
+		countingSortInts(values, n, min, max);
+	else if (passes == 0)
+		mergeSortInts(values, n);
+	else
+		radixSortInts(values, n, min, max, passes);
+}
+
+// set how many threads long lists are sorted with
+// 0 (the default) means one per online CPU
+void IntListSetSortThreads(int threads)
+{
+	numSortThreads = (threads < 0) ? 0 : threads;
+}
+
+// number of threads to sort n values with (1 if it isn't worth more)
+int sortThreads(int n)
+{
+	long threads = numSortThreads;
+
+	if (n < PARALLEL_MIN_SIZE)
+		return 1;
+	if (threads == 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > n / PARALLEL_MIN_CHUNK)
+		threads = n / PARALLEL_MIN_CHUNK;
+	if (threads > MAX_SORT_THREADS)
+		threads = MAX_SORT_THREADS;
+	return (threads < 1) ? 1 : threads;
+}
+
+// parallel sorting
+
+// what the threads of one parallel sort share
+typedef struct SortJob {
+	int *values;  // the array being sorted
+	int *sorted;  // where the chunks are sorted, before being merged
+	int  min, max;
+	int  nchunks;
+	int  bounds[MAX_SORT_THREADS + 1];  // chunk i is [bounds[i]..bounds[i+1])
+} SortJob;
+
+// one thread's part of a SortJob
+typedef struct SortTask {
+	SortJob *job;
+	int      id;
+} SortTask;
+
+// first index in a[lo..hi-1] (which is sorted) holding a value > v
+// (this function is local to this module)
+static int upperBound(const int *a, int lo, int hi, long long v)
+{
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (a[mid] <= v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// split the sorted chunks so that the first k values of the merged
+// result are, for each chunk i, job->sorted[bounds[i]..splits[i]-1]
+// values that are equal are taken from earlier chunks first, which
+// keeps the merge stable
+// (this function is local to this module)
+static void splitChunks(SortJob *job, int k, int splits[])
+{
+	const int *a = job->sorted;
+	long long lo = job->min, hi = job->max;
+	int taken, i;
+
+	// find the smallest v with at least k values <= v
+	while (lo < hi) {
+		long long mid = lo + (hi - lo) / 2;
+		int count = 0;
+		for (i = 0; i < job->nchunks; i++)
+			count += upperBound(a, job->bounds[i], job->bounds[i + 1], mid)
+			         - job->bounds[i];
+		if (count < k)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	// take everything < v, then as many of the values == v as needed,
+	// from the first chunk onwards
+	taken = 0;
+	for (i = 0; i < job->nchunks; i++) {
+		splits[i] = upperBound(a, job->bounds[i], job->bounds[i + 1], lo - 1);
+		taken += splits[i] - job->bounds[i];
+	}
+	for (i = 0; i < job->nchunks && taken < k; i++) {
+		int end = upperBound(a, splits[i], job->bounds[i + 1], lo);
+		int more = (end - splits[i] < k - taken) ? end - splits[i] : k - taken;
+		splits[i] += more;
+		taken += more;
+	}
+	assert(taken == k);
+}
+
+// whether the head of chunk i goes before the head of chunk j
+// (this function is local to this module)
+static int headBefore(const int *a, const int pos[], int i, int j)
+{
+	return a[pos[i]] < a[pos[j]] || (a[pos[i]] == a[pos[j]] && i < j);
+}
+
+// restore the heap order of heap[0..n-1] below heap[i]
+// (this function is local to this module)
+static void siftDown(const int *a, const int pos[], int heap[], int n, int i)
+{
+	for (;;) {
+		int least = i, l = 2 * i + 1, r = 2 * i + 2, tmp;
+		if (l < n && headBefore(a, pos, heap[l], heap[least])) least = l;
+		if (r < n && headBefore(a, pos, heap[r], heap[least])) least = r;
+		if (least == i)
+			return;
+		tmp = heap[i]; heap[i] = heap[least]; heap[least] = tmp;
+		i = least;
+	}
+}
+
+// sort one chunk, copying it into job->sorted first
+// (this function is local to this module)
+static void *sortChunk(void *arg)
+{
+	SortTask *task = arg;
+	SortJob *job = task->job;
+	int lo = job->bounds[task->id], hi = job->bounds[task->id + 1];
+
+	memcpy(job->sorted + lo, job->values + lo, (hi - lo) * sizeof (int));
+	sortIntsHere(job->sorted + lo, hi - lo, job->min, job->max);
+	return NULL;
+}
+
+// merge this task's share of every sorted chunk back into job->values
+// the share is the values that end up in the same place as the chunk
+// the task sorted, found by splitting every chunk at both ends
+// (this function is local to this module)
+static void *mergeChunks(void *arg)
+{
+	SortTask *task = arg;
+	SortJob *job = task->job;
+	const int *a = job->sorted;
+	int pos[MAX_SORT_THREADS], end[MAX_SORT_THREADS];
+	int heap[MAX_SORT_THREADS];
+	int k = job->bounds[task->id], n = 0, i;
+
+	splitChunks(job, job->bounds[task->id], pos);
+	splitChunks(job, job->bounds[task->id + 1], end);
+
+	// a heap of the chunks with something left, smallest head first
+	for (i = 0; i < job->nchunks; i++) {
+		if (pos[i] < end[i])
+			heap[n++] = i;
+	}
+	for (i = n / 2 - 1; i >= 0; i--)
+		siftDown(a, pos, heap, n, i);
+
+	while (n > 1) {
+		int c = heap[0];
+		job->values[k++] = a[pos[c]++];
+		if (pos[c] == end[c])
+			heap[0] = heap[--n];
+		siftDown(a, pos, heap, n, 0);
+	}
+	// just one chunk left: copy the rest of it
+	if (n == 1) {
+		int c = heap[0];
+		memcpy(job->values + k, a + pos[c], (end[c] - pos[c]) * sizeof (int));
+	}
+	return NULL;
+}
+
+// run f on each of the tasks, on a thread each, and wait for them all
+// the first task runs on this thread, as does any that can't get one
+// (this function is local to this module)
+static void runTasks(void *(*f)(void *), SortTask tasks[], int n)
+{
+	pthread_t threads[MAX_SORT_THREADS];
+	int started[MAX_SORT_THREADS];
+	int i;
+
+	for (i = 1; i < n; i++) {
+		started[i] = (pthread_create(&threads[i], NULL, f, &tasks[i]) == 0);
+		if (!started[i])
+			f(&tasks[i]);
+	}
+	f(&tasks[0]);
+	for (i = 1; i < n; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+	}
+}
+
+// sort values[0..n-1] into ascending order, all of which are in
+// [min..max], with whichever sort is quickest
+// on sortThreads(n) threads, each sorting a chunk, then each merging
+// one part of the result from all of the chunks; equal values keep
+// their order either way
+void sortInts(int *values, int n, int min, int max)
+{
+	SortTask tasks[MAX_SORT_THREADS];
+	SortJob job;
+	int threads = sortThreads(n);
+	int i;
+
+	// a counting sort is quicker on one thread than the rest on many
+	if (threads == 1 || countingSortFits(n, min, max)) {
+		sortIntsHere(values, n, min, max);
+		return;
+	}
+
+	job.values = values;
+	job.sorted = malloc(n * sizeof (int));
+	assert(job.sorted != NULL);
+	job.min = min;
+	job.max = max;
+	job.nchunks = threads;
+	for (i = 0; i <= threads; i++)
+		job.bounds[i] = (long)n * i / threads;
+	for (i = 0; i < threads; i++) {
+		tasks[i].job = &job;
+		tasks[i].id = i;
+	}
+
+	runTasks(sortChunk, tasks, threads);
+	runTasks(mergeChunks, tasks, threads);
+	free(job.sorted);
+}
+
+// count how many times each distinct value occurs in values[0..n-1]
+// returns an array of the counts, in ascending order of value, and
+// sets *ndistinct to its length (NULL and 0 if n is 0)
+// counts each value in place if the range is small, and otherwise
+// counts the runs in a sorted copy
+IntCount *countInts(const int *values, int n, int *ndistinct)
+{
+	IntCount *result;
+	int *sorted;
+	int min, max, distinct, i, k;
+
+	*ndistinct = 0;
+	if (n == 0)
+		return NULL;
+	min = max = values[0];
+	for (i = 1; i < n; i++) {
+		if (values[i] < min) min = values[i];
+		if (values[i] > max) max = values[i];
+	}
+
+	if (countingSortFits(n, min, max)) {
+		unsigned range = (unsigned)max - (unsigned)min + 1;
+		int *counts = calloc(range, sizeof (int));
+		assert(counts != NULL);
+		distinct = 0;
+		for (i = 0; i < n; i++) {
+			if (counts[(unsigned)values[i] - (unsigned)min]++ == 0)
+				distinct++;
+		}
+		result = malloc(distinct * sizeof (IntCount));
+		assert(result != NULL);
+		for (i = 0, k = 0; k < distinct; i++) {
+			if (counts[i] != 0) {
+				result[k].value = (int)((unsigned)min + i);
+				result[k].count = counts[i];
+				k++;
+			}
+		}
+		free(counts);
+		*ndistinct = distinct;
+		return result;
+	}
+
+	sorted = malloc(n * sizeof (int));
+	assert(sorted != NULL);
+	memcpy(sorted, values, n * sizeof (int));
+	sortInts(sorted, n, min, max);
+	distinct = 1;
+	for (i = 1; i < n; i++) {
+		if (sorted[i] != sorted[i - 1])
+			distinct++;
+	}
+	result = malloc(distinct * sizeof (IntCount));
+	assert(result != NULL);
+	result[0].value = sorted[0];
+	result[0].count = 1;
+	for (i = 1, k = 0; i < n; i++) {
+		if (sorted[i] == sorted[i - 1]) {
+			result[k].count++;
+		} else {
+			k++;
+			result[k].value = sorted[i];
+			result[k].count = 1;
+		}
+	}
+	free(sorted);
+	*ndistinct = distinct;
+	return result;
+}
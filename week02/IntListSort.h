@@ -0,0 +1,42 @@
+// IntListSort.h - Sorting arrays of integers, for the IntList
+// implementations (not part of the IntList interface)
+
+#ifndef INTLISTSORT_H
+#define INTLISTSORT_H
+
+#include "IntList.h"
+
+// number of radix sort passes to sort n values in [min..max],
+// or 0 if a merge sort would be quicker
+int radixPasses(int n, int min, int max);
+
+// sort values[0..n-1] into ascending order, all of which are in
+// [min..max], using the given number of radix sort passes
+void radixSortInts(int *values, int n, int min, int max, int passes);
+
+// sort values[0..n-1] into ascending order, with a merge sort
+void mergeSortInts(int *values, int n);
+
+// whether [min..max] is small enough, compared to n, for a counting
+// sort of n values in it to be quickest
+int countingSortFits(int n, int min, int max);
+
+// sort values[0..n-1] into ascending order, all of which are in
+// [min..max], with a counting sort
+void countingSortInts(int *values, int n, int min, int max);
+
+// number of threads to sort n values with (1 if it isn't worth more)
+// as set by IntListSetSortThreads()
+int sortThreads(int n);
+
+// sort values[0..n-1] into ascending order, all of which are in
+// [min..max], with whichever sort is quickest, on sortThreads(n)
+// threads; equal values keep their order
+void sortInts(int *values, int n, int min, int max);
+
+// count how many times each distinct value occurs in values[0..n-1]
+// returns an array of the counts, in ascending order of value, and
+// sets *ndistinct to its length (NULL and 0 if n is 0)
+IntCount *countInts(const int *values, int n, int *ndistinct);
+
+#endif
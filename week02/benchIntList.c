@@ -0,0 +1,245 @@
+// benchIntList.c - benchmark the IntList data type
+// Usage: ./bench [runs [seed]]
+//
+// Times getIntList(), IntListSortedCopy(), IntListUniqueSorted(),
+// IntListHistogram() and IntListPrint() on the
+// same inputs as timing.sh, but generated in memory, and without a
+// process or a shell pipeline per run. Each timing is repeated, after
+// a few warm up runs, and reported as CSV on stdout: the median, 95th
+// percentile and standard deviation in microseconds, and the number of
+// malloc(), calloc() and realloc() calls made per element.
+// (Allocations are counted by linking with -Wl,--wrap=malloc,
+//  -Wl,--wrap=calloc and -Wl,--wrap=realloc, so that IntList's calls
+//  come through here.)
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <assert.h>
+#include "IntList.h"
+
+#define WARMUPS 3
+#define DEFAULT_RUNS 21
+#define MAX_DUPE_VALUE 9999  // same as randl
+
+enum { OP_READ, OP_SORT, OP_UNIQUE, OP_HISTOGRAM, OP_PRINT, NUM_OPS };
+static const char *opNames[NUM_OPS] = {
+	"read", "sort", "unique", "histogram", "print"
+};
+
+static const int sizes[] = { 5000, 10000, 20000, 50000, 100000 };
+#define NUM_SIZES (int)(sizeof sizes / sizeof sizes[0])
+
+// allocation counting
+
+static long numAllocs = 0;
+
+void *__real_malloc(size_t);
+void *__real_calloc(size_t, size_t);
+void *__real_realloc(void *, size_t);
+
+void *__wrap_malloc(size_t n)
+{
+	numAllocs++;
+	return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	numAllocs++;
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t n)
+{
+	numAllocs++;
+	return __real_realloc(p, n);
+}
+
+// input generation
+
+static int compareInts(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+// fill values[0..n-1] in the given order ("sorted", "reverse" or
+// "random"), with values from 1..9999 if dupes, else a permutation
+// of 1..n
+static void makeInput(int *values, int n, const char *order, int dupes)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		values[i] = dupes ? 1 + rand() % MAX_DUPE_VALUE : i + 1;
+	if (strcmp(order, "random") == 0) {
+		for (i = n - 1; i > 0; i--) {
+			int j = rand() % (i + 1);
+			int tmp = values[i];
+			values[i] = values[j];
+			values[j] = tmp;
+		}
+		return;
+	}
+
+	qsort(values, n, sizeof (int), compareInts);
+	if (strcmp(order, "reverse") == 0) {
+		for (i = 0; i < n / 2; i++) {
+			int tmp = values[i];
+			values[i] = values[n - 1 - i];
+			values[n - 1 - i] = tmp;
+		}
+	}
+}
+
+// statistics
+
+static double now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// median, 95th percentile (nearest rank) and sample standard deviation
+// of times[0..n-1], which get sorted
+static void summarise(double *times, int n,
+                      double *median, double *p95, double *stddev)
+{
+	double mean = 0, sq = 0;
+	int i;
+
+	qsort(times, n, sizeof (double), compareDoubles);
+	*median = (n % 2) ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+	*p95 = times[(int)ceil(0.95 * n) - 1];
+	for (i = 0; i < n; i++)
+		mean += times[i];
+	mean /= n;
+	for (i = 0; i < n; i++)
+		sq += (times[i] - mean) * (times[i] - mean);
+	*stddev = (n > 1) ? sqrt(sq / (n - 1)) : 0;
+}
+
+// benchmarking
+
+// run one operation on the input once, returning how long it took in
+// microseconds, and adding the allocations it made to *allocs
+static double runOp(int op, const char *text, size_t textLen,
+                    const int *values, int n, FILE *devNull, long *allocs)
+{
+	IntList L = NULL, S = NULL;
+	IntCount *counts = NULL;
+	double start, end;
+	long before;
+	FILE *f;
+	int ncounts = 0, total = 0, i;
+
+	// set up what the operation works on, untimed
+	if (op != OP_READ) {
+		L = newIntList();
+		for (i = 0; i < n; i++)
+			IntListInsert(L, values[i]);
+		if (op == OP_PRINT)
+			S = IntListSortedCopy(L);
+	}
+	f = fmemopen((void *)text, textLen, "r");
+	assert(f != NULL);
+
+	before = numAllocs;
+	start = now();
+	switch (op) {
+	case OP_READ:  L = getIntList(f); break;
+	case OP_SORT:  S = IntListSortedCopy(L); break;
+	case OP_UNIQUE: S = IntListUniqueSorted(L); break;
+	case OP_HISTOGRAM: counts = IntListHistogram(L, &ncounts); break;
+	case OP_PRINT: IntListPrint(devNull, S); fflush(devNull); break;
+	}
+	end = now();
+	*allocs += numAllocs - before;
+
+	if (op == OP_UNIQUE) {
+		assert(IntListIsSorted(S) && IntListLength(S) <= n);
+	} else if (op == OP_HISTOGRAM) {
+		for (i = 0; i < ncounts; i++)
+			total += counts[i].count;
+		assert(total == n);
+		free(counts);
+	} else {
+		assert(IntListLength(op == OP_READ ? L : S) == n);
+	}
+	fclose(f);
+	freeIntList(L);
+	if (S != NULL)
+		freeIntList(S);
+	return end - start;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *orders[] = { "sorted", "reverse", "random" };
+	const char *name = strrchr(argv[0], '/') ? strrchr(argv[0], '/') + 1 : argv[0];
+	int runs = (argc > 1) ? atoi(argv[1]) : DEFAULT_RUNS;
+	FILE *devNull = fopen("/dev/null", "w");
+	int s, o, dupes, op, i;
+
+	if (runs < 1 || devNull == NULL) {
+		fprintf(stderr, "Usage: %s [runs [seed]]\n", argv[0]);
+		return 1;
+	}
+	srand((argc > 2) ? atoi(argv[2]) : 1);
+
+	printf("list,size,order,dupes,op,runs,median_us,p95_us,stddev_us,"
+	       "allocs_per_elem\n");
+	for (s = 0; s < NUM_SIZES; s++) {
+		int n = sizes[s];
+		int *values = malloc(n * sizeof (int));
+		char *text = malloc((size_t)n * 12 + 1);
+		double *times = malloc(runs * sizeof (double));
+		assert(values != NULL && text != NULL && times != NULL);
+
+		for (o = 0; o < 3; o++) {
+			for (dupes = 1; dupes >= 0; dupes--) {
+				size_t textLen = 0;
+
+				makeInput(values, n, orders[o], dupes);
+				for (i = 0; i < n; i++)
+					textLen += sprintf(text + textLen, "%d\n", values[i]);
+
+				for (op = 0; op < NUM_OPS; op++) {
+					double median, p95, stddev;
+					long allocs = 0, ignored = 0;
+
+					for (i = 0; i < WARMUPS; i++)
+						runOp(op, text, textLen, values, n, devNull, &ignored);
+					for (i = 0; i < runs; i++)
+						times[i] = runOp(op, text, textLen, values, n,
+						                 devNull, &allocs);
+
+					summarise(times, runs, &median, &p95, &stddev);
+					printf("%s,%d,%s,%s,%s,%d,%.1f,%.1f,%.1f,%.5f\n",
+					       name, n, orders[o], dupes ? "yes" : "no",
+					       opNames[op], runs, median, p95, stddev,
+					       (double)allocs / runs / n);
+					fflush(stdout);
+				}
+			}
+		}
+		free(values);
+		free(text);
+		free(times);
+	}
+
+	fclose(devNull);
+	return 0;
+}
@@ -1,5 +1,12 @@
 #!/bin/bash
 
+# Usage: ./timing.sh [usel ...]
+# Times each usel given (./usel by default), e.g. ./usel ./usel_array
+# to compare the IntList implementations, against sort -n
+# (These times include starting each process and making its input;
+#  `make bench.csv` times the IntList operations on their own)
+USELS=("${@:-./usel}")
+
 if [ "$(uname)" = "Darwin" ]; then
     RANDOMISE="gsort -R"
 else
@@ -13,10 +20,13 @@ function outputAvg {
     SAMPLESIZE="$1"; shift
     ITERATIONS=$((500000 / $SAMPLESIZE))
 
-    USEL_TIME=$(avgTime "./usel" "$SAMPLESIZE" "$ITERATIONS" "$INPUT")
+    USEL_TIMES=
+    for USEL in "${USELS[@]}"; do
+        USEL_TIMES="$USEL_TIMES $(avgTime "$USEL" "$SAMPLESIZE" "$ITERATIONS" "$INPUT") "$'\t\t'
+    done
     SORT_TIME=$(avgTime "sort -n" "$SAMPLESIZE" "$ITERATIONS" "$INPUT")
 
-    echo $SAMPLESIZE $'\t\t' $TYPE $'\t' $IS_DUPE $'\t\t' $ITERATIONS $'\t\t' $USEL_TIME $'\t\t' $SORT_TIME
+    echo $SAMPLESIZE $'\t\t' $TYPE $'\t' $IS_DUPE $'\t\t' $ITERATIONS $'\t\t' "$USEL_TIMES" $SORT_TIME
 }
 
 function avgTime {
@@ -25,15 +35,20 @@ function avgTime {
     ITERATIONS="$1"; shift
     INPUT="$1"; shift
 
-    /usr/bin/time -p bash -c "$(cat <<EOF
+    { time -p bash -c "$(cat <<EOF
 for ((I=0; I<$ITERATIONS; ++I)); do
     head -n $SAMPLESIZE <($INPUT) | $COMMAND > /dev/null
 done
 EOF
-    )" 2>&1 | grep real | awk '{printf ('$ITERATIONS' >= 20 ? "%.3f" : "%.2f"), $2 / '$ITERATIONS'}'
+    )"; } 2>&1 | grep real | awk '{printf ('$ITERATIONS' >= 20 ? "%.3f" : "%.2f"), $2 / '$ITERATIONS'}'
 }
 
-echo Input Size $'\t' Initial Order $'\t' Has Dupes $'\t' '# of Runs' $'\t' usel Time $'\t' sort Time
+USEL_HEADINGS=
+for USEL in "${USELS[@]}"; do
+    USEL_HEADINGS="$USEL_HEADINGS ${USEL##*/} Time "$'\t'
+done
+
+echo Input Size $'\t' Initial Order $'\t' Has Dupes $'\t' '# of Runs' $'\t' "$USEL_HEADINGS" sort Time
 
 for j in 5000 10000 20000 50000 100000; do
     outputAvg sorted yes "./randl $j | sort -n" $j
@@ -46,7 +61,8 @@ done
 
 cat <<EOF
 Small Files - Negligible time, because they're small.
-Bigger Files - Less Negligble time, because our algo sucks.
-Large Files - Huge time (usel), because our algos suck. a lot.
-Sort seems superior for all no trivial cases.
+Bigger Files - usel used to insert each value in order, O(n^2), and fell
+               far behind sort.
+Large Files - Now that usel merge or radix sorts, it keeps up with sort,
+              and most of the time goes on reading and writing numbers.
 EOF
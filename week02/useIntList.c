@@ -1,7 +1,10 @@
 // useIntList.c - testing IntList data type
+// Usage: ./usel [-t threads] < values
+// (threads to sort with; by default, one per online CPU)
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include "IntList.h"
 
@@ -9,6 +12,13 @@ int main(int argc, char *argv[])
 {
 	IntList myList, myOtherList;
 
+	if (argc == 3 && strcmp(argv[1], "-t") == 0 && atoi(argv[2]) > 0) {
+		IntListSetSortThreads(atoi(argv[2]));
+	} else if (argc != 1) {
+		fprintf(stderr, "Usage: %s [-t threads] < values\n", argv[0]);
+		return 1;
+	}
+
 	myList = getIntList(stdin);
 	assert(IntListOK(myList));
 
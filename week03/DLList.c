@@ -8,6 +8,10 @@
 #include <assert.h>
 #include "DLList.h"
 
+#define MARK_GAP 64  // about every 64th node is marked, to find nodes by number
+#define TEXT_BLOCK (1 << 20) // item strings are kept in blocks of 1MB
+#define NODE_BLOCK 4096      // and nodes in blocks of 4096
+
 // data structures representing DLList
 
 typedef struct DLListNode {
@@ -18,24 +22,98 @@ typedef struct DLListNode {
                    // pointer to next node in list
 } DLListNode;
 
+// a block of item strings, one after another
+typedef struct TextBlock {
+    struct TextBlock *next; // block before this one
+    size_t used;            // bytes of data in use
+    size_t size;            // bytes of data there are
+    char   data[];
+} TextBlock;
+
+// a block of nodes
+typedef struct NodeBlock {
+    struct NodeBlock *next; // block before this one
+    int    used;            // nodes in use (or freed)
+    DLListNode nodes[NODE_BLOCK];
+} NodeBlock;
+
 typedef struct DLListRep {
     int  nitems;      // count of items in list
     DLListNode *first; // first node in list
     DLListNode *curr;  // current node in list
     DLListNode *last;  // last node in list
+    int  currPos;     // position of curr (first is 1), 0 if none
+    DLListNode **marks; // marked nodes, in order along the list
+    int  *gaps;       // marks[j] is gaps[j] nodes on from marks[j-1] (or
+                      // from before the first node, for j == 0) ...
+    int  *sums;       // ... and sums[] is a Fenwick tree of gaps[], to
+                      // find (and move) the marks by position
+    int  nmarks;      // number of marks; nodes after the last are unmarked
+    int  maxMarks;    // room in marks[] and gaps[]
+    TextBlock *text;  // item strings, newest block first
+    NodeBlock *nodes; // nodes, newest block first
+    DLListNode *free; // deleted nodes, linked by next, to use again
 } DLListRep;
 
-// create a new DLListNode (private function)
-static DLListNode *newDLListNode(char *it)
+// start a new block of at least size bytes for item strings
+// (private function)
+static TextBlock *newTextBlock(DLList L, size_t size)
 {
-    DLListNode *new;
-    new = malloc(sizeof(DLListNode));
+    TextBlock *new;
+    if (size < TEXT_BLOCK) size = TEXT_BLOCK;
+    new = malloc(sizeof(TextBlock) + size);
     assert(new != NULL);
-    new->value = strdup(it);
+    new->next = L->text;
+    new->used = 0;
+    new->size = size;
+    L->text = new;
+    return new;
+}
+
+// copy a string into the list's text blocks (private function)
+// strings are never freed before the list, even if their item is
+static char *copyText(DLList L, char *it)
+{
+    size_t len = strlen(it) + 1;
+    TextBlock *b = L->text;
+    char *copy;
+    if (b == NULL || b->size - b->used < len)
+        b = newTextBlock(L, len);
+    copy = memcpy(b->data + b->used, it, len);
+    b->used += len;
+    return copy;
+}
+
+// create a new DLListNode, for a string already in the list's text
+// blocks (private function)
+static DLListNode *newDLListNode(DLList L, char *value)
+{
+    DLListNode *new;
+    if (L->free != NULL) {
+        new = L->free;
+        L->free = new->next;
+    } else {
+        if (L->nodes == NULL || L->nodes->used == NODE_BLOCK) {
+            NodeBlock *b = malloc(sizeof(NodeBlock));
+            assert(b != NULL);
+            b->next = L->nodes;
+            b->used = 0;
+            L->nodes = b;
+        }
+        new = &L->nodes->nodes[L->nodes->used++];
+    }
+    new->value = value;
     new->prev = new->next = NULL;
     return new;
 }
 
+// put a node from the list aside to use again (private function)
+static void freeDLListNode(DLList L, DLListNode *node)
+{
+    node->next = L->free;
+    L->free = node;
+}
+
 // create a new empty DLList
 DLList newDLList()
 {
@@ -47,6 +125,13 @@ DLList newDLList()
     L->first = NULL;
     L->last = NULL;
     L->curr = NULL;
+    L->currPos = 0;
+    L->marks = NULL;
+    L->gaps = L->sums = NULL;
+    L->nmarks = L->maxMarks = 0;
+    L->text = NULL;
+    L->nodes = NULL;
+    L->free = NULL;
     return L;
 }
 
@@ -54,49 +139,81 @@ DLList newDLList()
 void freeDLList(DLList L)
 {
     assert(L != NULL);
-    DLListNode *curr, *prev;
-    curr = L->first;
-    while (curr != NULL) {
-        prev = curr;
-        curr = curr->next;
-        free(prev->value);
-        free(prev);
+    while (L->text != NULL) {
+        TextBlock *b = L->text;
+        L->text = b->next;
+        free(b);
     }
+    while (L->nodes != NULL) {
+        NodeBlock *b = L->nodes;
+        L->nodes = b->next;
+        free(b);
+    }
+    free(L->marks);
+    free(L->gaps);
+    free(L->sums);
     free(L);
 }
 
-// trim off \n from strings (private function)
-// this is needed for getDLList() because of fgets()
-// alternatively, we could use the evil gets() function
-static char *trim(char *s)
+// add an item at the end of a list, for a string already in the
+// list's text blocks (private function)
+static void append(DLList L, char *value)
 {
-    int end = strlen(s)-1;
-    if (s[end] == '\n') s[end] = '\0';
-    return s;
+    DLListNode *new = newDLListNode(L, value);
+    if (L->last == NULL) {
+        L->first = L->last = new;
+    } else {
+        L->last->next = new;
+        new->prev = L->last;
+        L->last = new;
+    }
+    ++L->nitems;
 }
 
 // create an DLList by reading items from a file
 // assume that the file is open for reading
-// assume one item per line, line < 999 chars
+// assume one item per line, of any length
+// the file is read straight into text blocks, a block at a time, and
+// each '\n' found in a block is made the end of an item string
 DLList getDLList(FILE *in)
 {
     DLList L;
-    DLListNode *new;
-    char line[1000];
+    TextBlock *b, *prev = NULL;
+    size_t carry = 0; // bytes of a line left over from the last block
+    size_t want, got, start;
+    char *nl;
 
     L = newDLList();
-    while (fgets(line, 1000, in) != NULL) {
-        new = newDLListNode(trim(line));
-        if (L->last == NULL) {
-            L->first = L->last = new;
-        } else {
-            L->last->next = new;
-            new->prev = L->last;
-            L->last = new;
+    do {
+        // bigger blocks for lines that don't fit, with room for a '\0'
+        b = newTextBlock(L, 2 * carry + 1);
+        if (carry > 0) {
+            memcpy(b->data, prev->data + prev->used, carry);
+            b->used = carry;
+        }
+        want = b->size - b->used - 1;
+        got = fread(b->data + b->used, 1, want, in);
+        b->used += got;
+
+        start = 0;
+        while ((nl = memchr(b->data + start, '\n', b->used - start)) != NULL) {
+            *nl = '\0';
+            append(L, b->data + start);
+            start = nl - b->data + 1;
         }
-        ++L->nitems;
+        carry = b->used - start;
+        b->used = start;
+        prev = b;
+    } while (got == want);
+
+    // last line, without a '\n'
+    if (carry > 0) {
+        b->data[b->used + carry] = '\0';
+        append(L, b->data + b->used);
+        b->used += carry + 1;
     }
     L->curr = L->first;
+    L->currPos = (L->nitems > 0) ? 1 : 0;
     return L;
 }
 
@@ -105,8 +222,19 @@ void showDLList(FILE *out, DLList L)
 {
     assert(out != NULL); assert(L != NULL);
     DLListNode *curr;
-    for (curr = L->first; curr != NULL; curr = curr->next)
-        fprintf(out, "%s\n", curr->value);
+    for (curr = L->first; curr != NULL; curr = curr->next) {
+        fputs(curr->value, out);
+        putc('\n', out);
+    }
+}
+
+// position of marks[j], the sum of gaps[0..j] (private function)
+static int markPosition(DLList L, int j)
+{
+    int pos = 0;
+    for (j++; j > 0; j -= j & -j)
+        pos += L->sums[j];
+    return pos;
 }
 
 // check sanity of a DLList (for testing)
@@ -160,10 +288,187 @@ int validDLList(DLList L)
                 count, L->nitems);
         return 0;
     }
+    // check curr is where currPos says, and the marks are where their
+    // gaps (and sums) say, none of them too far apart for nodeAt()
+    int j = 0, at = 0;
+    count = 0;
+    for (curr = L->first; curr != NULL; curr = curr->next) {
+        count++;
+        if (curr == L->curr && count != L->currPos) {
+            fprintf(stderr, "Current node at %d, not %d\n", count, L->currPos);
+            return 0;
+        }
+        if (j < L->nmarks && count == at + L->gaps[j]) {
+            if (L->marks[j] != curr || L->gaps[j] > 2 * MARK_GAP
+                || markPosition(L, j) != count) {
+                fprintf(stderr, "Mark %d for node %d out of date\n", j, count);
+                return 0;
+            }
+            at = count;
+            j++;
+        }
+    }
+    if ((L->curr == NULL) != (L->currPos == 0) || j != L->nmarks) {
+        fprintf(stderr, "Current position or marks out of range\n");
+        return 0;
+    }
     // nothing went wrong => must be ok
     return 1;
 }
 
+// the node n steps forward (+ve) or backward (-ve) from a node,
+// which there must be (private function)
+static DLListNode *step(DLListNode *node, int n)
+{
+    for (; n > 0; n--)
+        node = node->next;
+    for (; n < 0; n++)
+        node = node->prev;
+    return node;
+}
+
+// make room for another mark (private function)
+static void growMarks(DLList L)
+{
+    if (L->nmarks < L->maxMarks)
+        return;
+    L->maxMarks = (L->maxMarks == 0) ? 16 : 2 * L->maxMarks;
+    L->marks = realloc(L->marks, L->maxMarks * sizeof(DLListNode *));
+    L->gaps = realloc(L->gaps, L->maxMarks * sizeof(int));
+    L->sums = realloc(L->sums, (L->maxMarks + 1) * sizeof(int));
+    assert(L->marks != NULL && L->gaps != NULL && L->sums != NULL);
+}
+
+// add d to gaps[j], so that marks[j] and those after it move along by
+// d positions (private function)
+static void shiftMarks(DLList L, int j, int d)
+{
+    L->gaps[j] += d;
+    for (j++; j <= L->nmarks; j += j & -j)
+        L->sums[j] += d;
+}
+
+// redo the sums from the gaps, after a mark has been put in or taken
+// out part way along (private function)
+static void resumMarks(DLList L)
+{
+    int i, up;
+    for (i = 1; i <= L->nmarks; i++)
+        L->sums[i] = L->gaps[i - 1];
+    for (i = 1; i <= L->nmarks; i++) {
+        up = i + (i & -i);
+        if (up <= L->nmarks)
+            L->sums[up] += L->sums[i];
+    }
+}
+
+// number of marks before position pos, with *at set to the position
+// of the last of them (0 if there are none) (private function)
+static int marksBefore(DLList L, int pos, int *at)
+{
+    int j = 0, bit;
+    *at = 0;
+    for (bit = 1; 2 * bit <= L->nmarks; bit *= 2)
+        ;
+    for (; bit > 0; bit /= 2) {
+        if (j + bit <= L->nmarks && *at + L->sums[j + bit] < pos) {
+            j += bit;
+            *at += L->sums[j];
+        }
+    }
+    return j;
+}
+
+// mark a node MARK_GAP on from the last mark, or the first node if
+// there are no marks yet (private function)
+static void addMark(DLList L)
+{
+    int j = L->nmarks, i = j + 1;
+    growMarks(L);
+    L->marks[j] = (j == 0) ? L->first : step(L->marks[j - 1], MARK_GAP);
+    L->gaps[j] = (j == 0) ? 1 : MARK_GAP;
+    L->nmarks = i;
+    // sums[i] covers gaps[i-lowbit(i)..i-1]
+    L->sums[i] = L->gaps[j] + (j > 0 ? markPosition(L, j - 1) : 0)
+               - (i - (i & -i) > 0 ? markPosition(L, i - (i & -i) - 1) : 0);
+}
+
+// note that a node has just been put in at position pos (private function)
+// the marks from there on move up one; a gap that gets too wide gets a
+// new mark part way along
+static void inserted(DLList L, int pos)
+{
+    int at, g, j = marksBefore(L, pos, &at);
+    if (j == L->nmarks)
+        return;
+    shiftMarks(L, j, 1);
+    if ((g = L->gaps[j]) <= 2 * MARK_GAP)
+        return;
+    growMarks(L);
+    memmove(&L->marks[j + 1], &L->marks[j], (L->nmarks - j) * sizeof(DLListNode *));
+    memmove(&L->gaps[j + 1], &L->gaps[j], (L->nmarks - j) * sizeof(int));
+    L->nmarks++;
+    L->marks[j] = step(L->marks[j + 1], MARK_GAP - g);
+    L->gaps[j] = MARK_GAP;
+    L->gaps[j + 1] = g - MARK_GAP;
+    resumMarks(L);
+}
+
+// note that node, at position pos, is about to be deleted (private
+// function)
+// the marks after it move down one; if it's marked, its mark goes to the
+// next node, or goes altogether if there's no unmarked node to take it
+static void deleting(DLList L, int pos, DLListNode *node)
+{
+    int at, j = marksBefore(L, pos, &at);
+    if (j == L->nmarks)
+        return;
+    if (L->marks[j] != node) {
+        shiftMarks(L, j, -1);
+    } else if (node->next != NULL
+               && (j + 1 == L->nmarks || L->marks[j + 1] != node->next)) {
+        L->marks[j] = node->next;
+        if (j + 1 < L->nmarks)
+            shiftMarks(L, j + 1, -1);
+    } else {
+        if (j + 1 < L->nmarks)
+            L->gaps[j + 1] += L->gaps[j] - 1;
+        L->nmarks--;
+        memmove(&L->marks[j], &L->marks[j + 1], (L->nmarks - j) * sizeof(DLListNode *));
+        memmove(&L->gaps[j], &L->gaps[j + 1], (L->nmarks - j) * sizeof(int));
+        resumMarks(L);
+    }
+}
+
+// node at position i, for 1 <= i <= nitems (private function)
+// walks from curr or last if that's close, and otherwise from the
+// nearest mark (or the first node), marking nodes up to i if it's past
+// the last mark
+static DLListNode *nodeAt(DLList L, int i)
+{
+    int at, j = marksBefore(L, i + 1, &at);
+    int fromCurr = (i > L->currPos) ? i - L->currPos : L->currPos - i;
+    int fromLast = L->nitems - i;
+    int fromMark = (j > 0) ? i - at : i - 1;
+    int toMark = (j < L->nmarks) ? at + L->gaps[j] - i : L->nitems;
+
+    if (fromCurr < fromMark && fromCurr < toMark && fromCurr <= fromLast)
+        return step(L->curr, i - L->currPos);
+    if (fromLast < fromMark && fromLast <= toMark)
+        return step(L->last, i - L->nitems);
+    if (toMark < fromMark)
+        return step(L->marks[j], -toMark);
+
+    if (j == L->nmarks && fromMark >= MARK_GAP) {
+        do {
+            addMark(L);
+            at = (j++ == 0) ? 1 : at + MARK_GAP;
+        } while (i - at >= MARK_GAP);
+        fromMark = i - at;
+    }
+    return (j > 0) ? step(L->marks[j - 1], fromMark) : step(L->first, fromMark);
+}
+
 // return item at current position
 char *DLListCurrent(DLList L)
 {
@@ -176,19 +481,25 @@ char *DLListCurrent(DLList L)
 // move current position (+ve forward, -ve backward)
 // return 1 if reach end of list during move
 // if current is currently null, return 1
+// short moves step node by node; long ones go via DLListMoveTo()
 int DLListMove(DLList L, int n)
 {
     assert(L != NULL);
     if (L->curr == NULL)
         return 1;
-    else if (n > 0) {
+    else if (n > MARK_GAP || n < -MARK_GAP) {
+        long to = (long)L->currPos + n;
+        return DLListMoveTo(L, to < 1 ? 1 : to > L->nitems ? L->nitems : to);
+    } else if (n > 0) {
         while (n > 0 && L->curr->next != NULL) {
             L->curr = L->curr->next;
+            L->currPos++;
             n--;
         }
     } else if (n < 0) {
         while (n < 0 && L->curr->prev != NULL) {
             L->curr = L->curr->prev;
+            L->currPos--;
             n++;
         }
     }
@@ -197,11 +508,18 @@ int DLListMove(DLList L, int n)
 
 // move to specified position in list
 // i'th node, assuming first node has i==1
+// takes O(log nitems + MARK_GAP) steps, once the nodes before i have
+// been marked
 int DLListMoveTo(DLList L, int i)
 {
     assert(L != NULL); assert(i > 0);
-    L->curr = L->first;
-    return DLListMove(L, i-1);
+    if (L->curr == NULL)
+        return 1;
+    if (i > L->nitems)
+        i = L->nitems;
+    L->curr = nodeAt(L, i);
+    L->currPos = i;
+    return (L->curr == L->first || L->curr == L->last);
 }
 
 // insert an item before current item
@@ -209,11 +527,12 @@ int DLListMoveTo(DLList L, int i)
 void DLListBefore(DLList L, char *it)
 {
     assert(L != NULL);
-    DLListNode *new = newDLListNode(it);
+    DLListNode *new = newDLListNode(L, copyText(L, it));
     if (L->curr == NULL){
         L->curr = L->first = L->last = new;
         new->next = NULL;
         new->prev = NULL;
+        L->currPos = 1;
     } else if (L->curr == L->first) {
         new->next = L->curr;
         new->prev = NULL;
@@ -230,6 +549,7 @@ void DLListBefore(DLList L, char *it)
         L->curr = new;
     }
     ++L->nitems;
+    inserted(L, L->currPos);
 }
 
 // insert an item after current item
@@ -237,11 +557,12 @@ void DLListBefore(DLList L, char *it)
 void DLListAfter(DLList L, char *it)
 {
     assert(L != NULL);
-    DLListNode *new = newDLListNode(it);
+    DLListNode *new = newDLListNode(L, copyText(L, it));
     if (L->curr == NULL) {
         L->curr = L->first = L->last = new;
         new->next = NULL;
         new->prev = NULL;
+        L->currPos = 1;
     } else if (L->curr == L->last) {
         new->next = NULL;
         new->prev = L->curr;
@@ -249,6 +570,7 @@ void DLListAfter(DLList L, char *it)
         L->curr->next = new;
         L->curr = new;
         L->last = new;
+        ++L->currPos;
     } else {
         new->next = L->curr->next;
         new->prev = L->curr;
@@ -256,8 +578,10 @@ void DLListAfter(DLList L, char *it)
         L->curr->next->prev = new;
         L->curr->next = new;
         L->curr = new;
+        ++L->currPos;
     }
     ++L->nitems;
+    inserted(L, L->currPos);
 }
 
 // delete current item
@@ -269,35 +593,43 @@ void DLListDelete(DLList L)
     assert (L != NULL);
     if (L->curr == NULL){
         return;
-    } else if (L->first == L->last) {
-        free(L->curr->value);
-        free(L->curr);
+    }
+    deleting(L, L->currPos, L->curr);
+    if (L->first == L->last) {
+        freeDLListNode(L, L->curr);
         L->curr = NULL;
         L->first = NULL;
         L->last = NULL;
+        L->currPos = 0;
     } else if (L->curr == L->last) {
         L->curr->prev->next = NULL;
         L->last = L->curr->prev;
-        free(L->curr->value);
-        free(L->curr);
+        freeDLListNode(L, L->curr);
         L->curr = L->last;
+        L->currPos--;
     } else if (L->curr == L->first) {
         L->curr->next->prev = NULL;
         L->first = L->curr->next;
-        free(L->curr->value);
-        free(L->curr);
+        freeDLListNode(L, L->curr);
         L->curr = L->first;
     } else {
         L->curr->prev->next = L->curr->next;
         L->curr->next->prev = L->curr->prev;
         DLListNode *newCurrent = L->curr->next;
-        free(L->curr->value);
-        free(L->curr);
+        freeDLListNode(L, L->curr);
         L->curr = newCurrent;
     }
     --L->nitems;
 }
 
+// return position of current item (first item is 1)
+// if list is empty, return 0
+int DLListPosition(DLList L)
+{
+    assert(L != NULL);
+    return L->currPos;
+}
+
 // return number of elements in a list
 int DLListLength(DLList L)
 {
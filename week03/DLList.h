@@ -9,7 +9,8 @@
 #include "DLList.h"
 
 // External view of DLList
-// Implementation given in DLList.c
+// Implementations given in DLList.c (a node per item)
+// and DLListPiece.c (a piece table over the file, for lines of text)
 // Implements a DLList of strings (i.e. items are strings)
 
 typedef struct DLListRep *DLList;
@@ -31,6 +32,9 @@ void showDLList(FILE *, DLList);
 int validDLList(DLList);
 
 // return item at current position
+// the string is only good until the next call on the list: some
+// implementations (e.g. DLListPiece.c) return a scratch copy that the
+// next call overwrites, so copy it to keep it any longer
 char *DLListCurrent(DLList);
 
 // move current position (+ve forward, -ve backward)
@@ -55,6 +59,10 @@ void DLListAfter(DLList, char *);
 // if current was only item, current becomes null
 void DLListDelete(DLList);
 
+// return position of current item (first item is 1)
+// if list is empty, return 0
+int DLListPosition(DLList);
+
 // return number of elements in a list
 int DLListLength(DLList);
 
@@ -0,0 +1,539 @@
+// DLListPiece.c - Implementation of DLList ADT as a piece table
+// Same interface as DLList.c, but the file is mapped into memory rather
+// than copied, and the list is kept as a table of pieces, each holding
+// some whole lines of either the file or an append-only buffer of the
+// lines inserted since
+// The pieces are kept in a treap, in order, with each subtree knowing
+// how many bytes and lines it holds, so that finding line N takes
+// O(log n) time. The file is only split into pieces (about CHUNK bytes
+// at a time) as far as lines are asked for, so opening it takes O(1)
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "DLList.h"
+
+#define CHUNK 8192       // the file is split into pieces of about this
+#define MIN_BUF_SIZE 4096
+
+// data structures representing DLList
+
+typedef struct Piece {
+    int     added;     // whether text is in the add buffer (else file)
+    size_t  start;     // where the text starts in its buffer
+    size_t  len;       // bytes of text; always ends with '\n'
+    int     nlines;    // lines of text (number of '\n's)
+    unsigned prio;     // treap priority; no more than its children's
+    size_t  sumLen;    // total len of this subtree
+    int     sumLines;  // total nlines of this subtree
+    struct Piece *left;  // pieces before this one
+    struct Piece *right; // pieces after this one
+} Piece;
+
+typedef struct DLListRep {
+    int     nitems;    // count of lines in pieces so far
+    int     curr;      // current line number (1..nitems), 0 if none
+    Piece  *root;      // pieces holding lines 1..nitems
+    char   *file;      // contents of the file the list was read from
+    size_t  fileSize;
+    int     mapped;    // whether file is mmap'd (else malloc'd)
+    size_t  unread;    // file[unread..fileSize-1] isn't in pieces yet
+    char   *add;       // inserted lines, one after another
+    size_t  addLen, addSize;
+    char   *line;      // copy of current line, for DLListCurrent()
+    size_t  lineSize;
+    unsigned seed;     // for piece priorities
+} DLListRep;
+
+#define LEN(p)   ((p) == NULL ? 0 : (p)->sumLen)
+#define LINES(p) ((p) == NULL ? 0 : (p)->sumLines)
+
+// text held in a piece (private function)
+static char *pieceText(DLList L, Piece *p)
+{
+    return (p->added ? L->add : L->file) + p->start;
+}
+
+// number of lines (newlines) in s[0..n-1] (private function)
+static int countLines(const char *s, size_t n)
+{
+    int count = 0;
+    size_t i;
+    for (i = 0; i < n; i++)
+        count += (s[i] == '\n');
+    return count;
+}
+
+// create a new Piece (private function)
+static Piece *newPiece(DLList L, int added, size_t start, size_t len,
+                       int nlines)
+{
+    Piece *new;
+    new = malloc(sizeof(Piece));
+    assert(new != NULL);
+    new->added = added;
+    new->start = start;
+    new->len = new->sumLen = len;
+    new->nlines = new->sumLines = nlines;
+    // xorshift, for priorities in no particular order
+    L->seed ^= L->seed << 13;
+    L->seed ^= L->seed >> 17;
+    L->seed ^= L->seed << 5;
+    new->prio = L->seed;
+    new->left = new->right = NULL;
+    return new;
+}
+
+// free a tree of pieces (private function)
+static void freePieces(Piece *p)
+{
+    if (p == NULL) return;
+    freePieces(p->left);
+    freePieces(p->right);
+    free(p);
+}
+
+// recompute the totals for a piece's subtree (private function)
+static void update(Piece *p)
+{
+    p->sumLen = LEN(p->left) + p->len + LEN(p->right);
+    p->sumLines = LINES(p->left) + p->nlines + LINES(p->right);
+}
+
+// join two trees of pieces, all of a before all of b (private function)
+static Piece *merge(Piece *a, Piece *b)
+{
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (a->prio <= b->prio) {
+        a->right = merge(a->right, b);
+        update(a);
+        return a;
+    } else {
+        b->left = merge(a, b->left);
+        update(b);
+        return b;
+    }
+}
+
+// split a tree of pieces into the first pos bytes (*l) and the rest
+// (*r), cutting a piece in two if need be; pos must start a line
+// (private function)
+static void split(DLList L, Piece *p, size_t pos, Piece **l, Piece **r)
+{
+    if (p == NULL) {
+        *l = *r = NULL;
+    } else if (pos <= LEN(p->left)) {
+        split(L, p->left, pos, l, &p->left);
+        update(p);
+        *r = p;
+    } else if (pos >= LEN(p->left) + p->len) {
+        split(L, p->right, pos - LEN(p->left) - p->len, &p->right, r);
+        update(p);
+        *l = p;
+    } else {
+        // both halves keep p's priority, so both are still treaps
+        size_t at = pos - LEN(p->left);
+        int nlines = countLines(pieceText(L, p), at);
+        Piece *rest = newPiece(L, p->added, p->start + at, p->len - at,
+                               p->nlines - nlines);
+        rest->prio = p->prio;
+        rest->right = p->right;
+        p->right = NULL;
+        p->len = at;
+        p->nlines = nlines;
+        update(rest);
+        update(p);
+        *l = p;
+        *r = rest;
+    }
+}
+
+// append text, and a '\n', to the add buffer
+// returns where it starts (private function)
+static size_t addLine(DLList L, const char *text, size_t len)
+{
+    size_t start = L->addLen;
+    if (L->addLen + len + 1 > L->addSize) {
+        size_t size = L->addSize < MIN_BUF_SIZE ? MIN_BUF_SIZE : L->addSize;
+        while (size < L->addLen + len + 1)
+            size *= 2;
+        L->add = realloc(L->add, size);
+        assert(L->add != NULL);
+        L->addSize = size;
+    }
+    memcpy(L->add + L->addLen, text, len);
+    L->add[L->addLen + len] = '\n';
+    L->addLen += len + 1;
+    return start;
+}
+
+// split the next CHUNK or so bytes of the file, up to the end of a
+// line, into a new piece after all of the others
+// returns 0 if the whole file is already in pieces (private function)
+static int readMore(DLList L)
+{
+    size_t start = L->unread, end;
+    char *nl;
+    Piece *new;
+
+    if (start == L->fileSize)
+        return 0;
+    end = (L->fileSize - start > CHUNK) ? start + CHUNK : L->fileSize;
+    nl = memrchr(L->file + start, '\n', end - start);
+    if (nl == NULL) // line longer than CHUNK
+        nl = memchr(L->file + end, '\n', L->fileSize - end);
+
+    if (nl != NULL) {
+        end = nl - L->file + 1;
+        new = newPiece(L, 0, start, end - start,
+                       countLines(L->file + start, end - start));
+    } else {
+        // last line has no '\n'; give it one in the add buffer
+        end = L->fileSize;
+        new = newPiece(L, 1, addLine(L, L->file + start, end - start),
+                       end - start + 1, 1);
+    }
+    L->root = merge(L->root, new);
+    L->nitems += new->nlines;
+    L->unread = end;
+    return 1;
+}
+
+// make sure line i is in pieces, if there is one
+// returns 0 if the list has fewer than i lines (private function)
+static int haveLine(DLList L, int i)
+{
+    while (L->nitems < i && readMore(L))
+        ;
+    return (L->nitems >= i);
+}
+
+// find where line i starts, for 1 <= i <= nitems+1 (private function)
+// sets *piece and *offset to the piece it's in and where in that piece
+// (NULL if i is nitems+1), and returns where it is in the whole list
+static size_t findLine(DLList L, int i, Piece **piece, size_t *offset)
+{
+    Piece *p = L->root;
+    int skip = i - 1; // lines before line i
+    size_t pos = 0;
+
+    while (p != NULL) {
+        if (skip < LINES(p->left)) {
+            p = p->left;
+            continue;
+        }
+        skip -= LINES(p->left);
+        pos += LEN(p->left);
+        if (skip < p->nlines) {
+            const char *s = pieceText(L, p);
+            size_t at = 0;
+            while (skip-- > 0)
+                at = (char *)memchr(s + at, '\n', p->len - at) - s + 1;
+            *piece = p;
+            *offset = at;
+            return pos + at;
+        }
+        skip -= p->nlines;
+        pos += p->len;
+        p = p->right;
+    }
+    *piece = NULL;
+    *offset = 0;
+    return pos;
+}
+
+// insert an item as a new line starting at pos (private function)
+static void insertLine(DLList L, size_t pos, char *it)
+{
+    size_t len = strlen(it);
+    Piece *new = newPiece(L, 1, addLine(L, it, len), len + 1, 1);
+    Piece *before, *after;
+    split(L, L->root, pos, &before, &after);
+    L->root = merge(merge(before, new), after);
+    ++L->nitems;
+}
+
+// create a new empty DLList
+DLList newDLList()
+{
+    struct DLListRep *L;
+
+    L = malloc(sizeof (struct DLListRep));
+    assert (L != NULL);
+    L->nitems = 0;
+    L->curr = 0;
+    L->root = NULL;
+    L->file = NULL;
+    L->fileSize = 0;
+    L->mapped = 0;
+    L->unread = 0;
+    L->add = NULL;
+    L->addLen = L->addSize = 0;
+    L->line = NULL;
+    L->lineSize = 0;
+    L->seed = 2463534242u;
+    return L;
+}
+
+// free up all space associated with list
+void freeDLList(DLList L)
+{
+    assert(L != NULL);
+    freePieces(L->root);
+    if (L->mapped)
+        munmap(L->file, L->fileSize);
+    else
+        free(L->file);
+    free(L->add);
+    free(L->line);
+    free(L);
+}
+
+// create an DLList by reading items from a file
+// assume that the file is open for reading
+// a regular file is mapped into memory, not read; anything else is
+// read in full; either way, lines can be of any length
+DLList getDLList(FILE *in)
+{
+    DLList L;
+    struct stat st;
+    long at = ftell(in);
+
+    L = newDLList();
+    if (at >= 0 && fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode)
+        && st.st_size > at) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                         fileno(in), 0);
+        if (map != MAP_FAILED) {
+            L->file = map;
+            L->fileSize = st.st_size;
+            L->mapped = 1;
+            L->unread = at;
+        }
+    }
+    if (!L->mapped) {
+        size_t size = MIN_BUF_SIZE, got;
+        L->file = malloc(size);
+        assert(L->file != NULL);
+        while ((got = fread(L->file + L->fileSize, 1,
+                            size - L->fileSize, in)) > 0) {
+            L->fileSize += got;
+            if (L->fileSize == size) {
+                size *= 2;
+                L->file = realloc(L->file, size);
+                assert(L->file != NULL);
+            }
+        }
+    }
+    L->curr = haveLine(L, 1) ? 1 : 0;
+    return L;
+}
+
+// write out a tree of pieces, in order (private function)
+static void showPieces(FILE *out, DLList L, Piece *p)
+{
+    if (p == NULL) return;
+    showPieces(out, L, p->left);
+    fwrite(pieceText(L, p), 1, p->len, out);
+    showPieces(out, L, p->right);
+}
+
+// display items from a DLList, one per line
+// the part of the file not yet in pieces is written out as it is
+void showDLList(FILE *out, DLList L)
+{
+    assert(out != NULL); assert(L != NULL);
+    showPieces(out, L, L->root);
+    if (L->unread < L->fileSize) {
+        fwrite(L->file + L->unread, 1, L->fileSize - L->unread, out);
+        if (L->file[L->fileSize - 1] != '\n')
+            fputc('\n', out);
+    }
+}
+
+// check a tree of pieces, setting *count to its number of pieces
+// (private function)
+static int validPieces(DLList L, Piece *p, int *count)
+{
+    int nleft, nright;
+    if (p == NULL) {
+        *count = 0;
+        return 1;
+    }
+    if (!validPieces(L, p->left, &nleft) || !validPieces(L, p->right, &nright))
+        return 0;
+    *count = nleft + 1 + nright;
+    if ((p->left != NULL && p->left->prio < p->prio) ||
+        (p->right != NULL && p->right->prio < p->prio)) {
+        fprintf(stderr, "Piece out of heap order\n");
+        return 0;
+    }
+    if (p->len == 0 || pieceText(L, p)[p->len - 1] != '\n' ||
+        countLines(pieceText(L, p), p->len) != p->nlines) {
+        fprintf(stderr, "Piece not %d whole lines\n", p->nlines);
+        return 0;
+    }
+    if (p->sumLen != LEN(p->left) + p->len + LEN(p->right) ||
+        p->sumLines != LINES(p->left) + p->nlines + LINES(p->right)) {
+        fprintf(stderr, "Piece totals mismatch\n");
+        return 0;
+    }
+    return 1;
+}
+
+// check sanity of a DLList (for testing)
+int validDLList(DLList L)
+{
+    int count;
+    if (L == NULL) {
+        fprintf(stderr, "DLList is null\n");
+        return 0;
+    }
+    if (!validPieces(L, L->root, &count))
+        return 0;
+    if (LINES(L->root) != L->nitems) {
+        fprintf(stderr, "Line count mismatch; counted=%d, nitems=%d\n",
+                LINES(L->root), L->nitems);
+        return 0;
+    }
+    if (L->curr < 0 || L->curr > L->nitems ||
+        (L->curr == 0) != (L->nitems == 0)) {
+        fprintf(stderr, "Current line %d out of range\n", L->curr);
+        return 0;
+    }
+    // nothing went wrong => must be ok
+    return 1;
+}
+
+// return item at current position
+// (a copy, which is only good until the list is next used)
+char *DLListCurrent(DLList L)
+{
+    Piece *p;
+    size_t at, len;
+    const char *s;
+
+    assert(L != NULL);
+    if (L->curr == 0)
+        return NULL;
+    findLine(L, L->curr, &p, &at);
+    s = pieceText(L, p) + at;
+    len = (const char *)memchr(s, '\n', p->len - at) - s;
+    if (len + 1 > L->lineSize) {
+        L->lineSize = len + 1;
+        L->line = realloc(L->line, L->lineSize);
+        assert(L->line != NULL);
+    }
+    memcpy(L->line, s, len);
+    L->line[len] = '\0';
+    return L->line;
+}
+
+// move current position (+ve forward, -ve backward)
+// return 1 if reach end of list during move
+// if current is currently null, return 1
+int DLListMove(DLList L, int n)
+{
+    assert(L != NULL);
+    if (L->curr == 0)
+        return 1;
+    else if (n > 0) {
+        int to = (n > INT_MAX - L->curr) ? INT_MAX : L->curr + n;
+        L->curr = haveLine(L, to) ? to : L->nitems;
+    } else if (n < 0) {
+        L->curr = (n < 1 - L->curr) ? 1 : L->curr + n;
+    }
+    return (L->curr == 1 || !haveLine(L, L->curr + 1));
+}
+
+// move to specified position in list
+// i'th node, assuming first node has i==1
+int DLListMoveTo(DLList L, int i)
+{
+    assert(L != NULL); assert(i > 0);
+    L->curr = (L->nitems > 0) ? 1 : 0;
+    return DLListMove(L, i-1);
+}
+
+// insert an item before current item
+// new item becomes current item
+void DLListBefore(DLList L, char *it)
+{
+    Piece *p;
+    size_t at;
+    assert(L != NULL);
+    if (L->curr == 0) {
+        insertLine(L, 0, it);
+        L->curr = 1;
+    } else {
+        insertLine(L, findLine(L, L->curr, &p, &at), it);
+    }
+}
+
+// insert an item after current item
+// new item becomes current item
+void DLListAfter(DLList L, char *it)
+{
+    Piece *p;
+    size_t at;
+    assert(L != NULL);
+    if (L->curr == 0) {
+        insertLine(L, 0, it);
+        L->curr = 1;
+    } else {
+        // lines are whole in pieces, so the next line's start is there
+        // even if the next line isn't
+        insertLine(L, findLine(L, L->curr + 1, &p, &at), it);
+        ++L->curr;
+    }
+}
+
+// delete current item
+// new item becomes item following current
+// if current was last, current becomes new last
+// if current was only item, current becomes null
+void DLListDelete(DLList L)
+{
+    Piece *p, *before, *line, *after;
+    size_t start, end, at;
+
+    assert (L != NULL);
+    if (L->curr == 0)
+        return;
+    start = findLine(L, L->curr, &p, &at);
+    end = findLine(L, L->curr + 1, &p, &at);
+    split(L, L->root, start, &before, &after);
+    split(L, after, end - start, &line, &after);
+    freePieces(line);
+    L->root = merge(before, after);
+    --L->nitems;
+    if (!haveLine(L, L->curr))
+        L->curr = L->nitems;
+}
+
+// return position of current item (first item is 1)
+// if list is empty, return 0
+int DLListPosition(DLList L)
+{
+    assert(L != NULL);
+    return L->curr;
+}
+
+// return number of elements in a list
+// (the whole file has to be split into pieces to know)
+int DLListLength(DLList L)
+{
+    haveLine(L, INT_MAX);
+    return (L->nitems);
+}
+
+// is the list empty?
+int DLListIsEmpty(DLList L)
+{
+    return (L->nitems == 0 && L->unread == L->fileSize);
+}
@@ -0,0 +1,261 @@
+// Journal.c - Implementation of undo/redo journal of edits to a DLList
+// Every edit is remembered as the item inserted or deleted and its
+// position in the list, which is all it takes to undo or redo it: an
+// undone insert is a delete at the same position, and vice versa
+// Edits since the last save are also kept as the lines to be appended
+// to the save file, so saving writes only what's new
+// A save file starts with a line "=size mtime" for the file that the
+// list came from, and is only replayed if that file still matches
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "Journal.h"
+
+#define MIN_SIZE 64
+
+// data structures representing Journal
+
+typedef struct Edit {
+    int   insert; // whether item was inserted (else deleted)
+    int   pos;    // position item was inserted at (or deleted from)
+    int   curr;   // position of the current item before the edit
+    char *item;   // copy of item
+} Edit;
+
+typedef struct JournalRep {
+    Edit *edits;    // edits[0..ndone-1] have been made, and
+    int   ndone;    // edits[ndone..nedits-1] have been undone
+    int   nedits;
+    int   maxEdits; // room in edits[]
+    char *unsaved;  // lines for the save file since the last save
+    size_t len;     // bytes in unsaved
+    size_t size;    // room in unsaved
+} JournalRep;
+
+// create a new empty Journal
+Journal newJournal()
+{
+    struct JournalRep *J;
+
+    J = malloc(sizeof (struct JournalRep));
+    assert (J != NULL);
+    J->edits = NULL;
+    J->ndone = J->nedits = J->maxEdits = 0;
+    J->unsaved = NULL;
+    J->len = J->size = 0;
+    return J;
+}
+
+// free up all space associated with journal
+void freeJournal(Journal J)
+{
+    int i;
+    assert(J != NULL);
+    for (i = 0; i < J->nedits; i++)
+        free(J->edits[i].item);
+    free(J->edits);
+    free(J->unsaved);
+    free(J);
+}
+
+// insert an item as the pos'th item of a list, and make it current
+// (private function)
+static void insertAt(DLList L, int pos, char *item)
+{
+    // after the item before it, unless it's first
+    DLListMoveTo(L, pos > 1 ? pos - 1 : 1);
+    if (pos > 1)
+        DLListAfter(L, item);
+    else
+        DLListBefore(L, item);
+}
+
+// delete the pos'th item of a list (private function)
+static void deleteAt(DLList L, int pos)
+{
+    DLListMoveTo(L, pos);
+    DLListDelete(L);
+}
+
+// note an edit, made or undone, for the save file
+// one line each: "+pos item" for an insert, "-pos" for a delete
+// (private function)
+static void unsaved(Journal J, int insert, int pos, char *item)
+{
+    size_t need = 16 + (insert ? strlen(item) : 0);
+    if (J->len + need > J->size) {
+        J->size = J->size < MIN_SIZE ? MIN_SIZE : J->size;
+        while (J->len + need > J->size)
+            J->size *= 2;
+        J->unsaved = realloc(J->unsaved, J->size);
+        assert(J->unsaved != NULL);
+    }
+    if (insert)
+        J->len += sprintf(J->unsaved + J->len, "+%d %s\n", pos, item);
+    else
+        J->len += sprintf(J->unsaved + J->len, "-%d\n", pos);
+}
+
+// remember an edit just made, forgetting any edits undone before it
+// (private function)
+static void remember(Journal J, int insert, int pos, int curr, char *item)
+{
+    while (J->nedits > J->ndone)
+        free(J->edits[--J->nedits].item);
+    if (J->nedits == J->maxEdits) {
+        J->maxEdits = (J->maxEdits == 0) ? MIN_SIZE : 2 * J->maxEdits;
+        J->edits = realloc(J->edits, J->maxEdits * sizeof (Edit));
+        assert(J->edits != NULL);
+    }
+    J->edits[J->nedits].insert = insert;
+    J->edits[J->nedits].pos = pos;
+    J->edits[J->nedits].curr = curr;
+    J->edits[J->nedits].item = strdup(item);
+    assert(J->edits[J->nedits].item != NULL);
+    J->ndone = ++J->nedits;
+    unsaved(J, insert, pos, item);
+}
+
+// insert an item before current item, as DLListBefore(), and
+// remember it
+void JournalBefore(Journal J, DLList L, char *it)
+{
+    int curr;
+    assert(J != NULL);
+    curr = DLListPosition(L);
+    DLListBefore(L, it);
+    remember(J, 1, DLListPosition(L), curr, it);
+}
+
+// insert an item after current item, as DLListAfter(), and
+// remember it
+void JournalAfter(Journal J, DLList L, char *it)
+{
+    int curr;
+    assert(J != NULL);
+    curr = DLListPosition(L);
+    DLListAfter(L, it);
+    remember(J, 1, DLListPosition(L), curr, it);
+}
+
+// delete current item, as DLListDelete(), and remember it
+void JournalDelete(Journal J, DLList L)
+{
+    int pos;
+    char *item;
+    assert(J != NULL);
+    pos = DLListPosition(L);
+    if ((item = DLListCurrent(L)) == NULL)
+        return;
+    // remember the item first; DLListDelete() may free it
+    remember(J, 0, pos, pos, item);
+    DLListDelete(L);
+}
+
+// undo the last edit that hasn't been undone
+// a deleted item comes back as the current item; after an insert, the
+// item that was current before it is current again
+// return 0 if there is nothing to undo
+int JournalUndo(Journal J, DLList L)
+{
+    Edit *e;
+    assert(J != NULL);
+    if (J->ndone == 0)
+        return 0;
+    e = &J->edits[--J->ndone];
+    if (e->insert) {
+        deleteAt(L, e->pos);
+        // back to the item that was current before the insert
+        if (e->curr > 0)
+            DLListMoveTo(L, e->curr);
+    } else {
+        insertAt(L, e->pos, e->item);
+    }
+    unsaved(J, !e->insert, e->pos, e->item);
+    return 1;
+}
+
+// redo the last edit undone, if nothing has been edited since
+// return 0 if there is nothing to redo
+int JournalRedo(Journal J, DLList L)
+{
+    Edit *e;
+    assert(J != NULL);
+    if (J->ndone == J->nedits)
+        return 0;
+    e = &J->edits[J->ndone++];
+    if (e->insert)
+        insertAt(L, e->pos, e->item);
+    else
+        deleteAt(L, e->pos);
+    unsaved(J, e->insert, e->pos, e->item);
+    return 1;
+}
+
+// the line that starts a save file, for the file a list came from
+// (private function)
+static void stamp(char *line, struct stat *orig)
+{
+    sprintf(line, "=%lld %lld.%09ld\n", (long long)orig->st_size,
+            (long long)orig->st_mtim.tv_sec, (long)orig->st_mtim.tv_nsec);
+}
+
+// append the edits (and undos and redos) made since the last save to
+// a file, as one line each, after a line with the size and modification
+// time (from stat()) of the file the list came from if the file is empty
+// assume that the file is open for appending
+// return 0 if they couldn't be written
+int JournalSave(Journal J, FILE *out, struct stat *orig)
+{
+    char first[64];
+    assert(J != NULL); assert(out != NULL); assert(orig != NULL);
+    if (fseek(out, 0, SEEK_END) != 0)
+        return 0;
+    if (ftell(out) == 0) {
+        stamp(first, orig);
+        if (fputs(first, out) == EOF)
+            return 0;
+    }
+    if (fwrite(J->unsaved, 1, J->len, out) != J->len || fflush(out) != 0)
+        return 0;
+    J->len = 0;
+    return 1;
+}
+
+// make the edits saved in a file to a list, without remembering them,
+// if they were made to the file the list came from, as its stat() is now
+// assume that the file is open for reading
+// return number of edits made, or -1 if the edits were made to some other
+// file (or the same file before it last changed)
+int JournalReplay(DLList L, FILE *in, struct stat *orig)
+{
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    int pos, start, count = 0;
+    char first[64];
+
+    assert(orig != NULL);
+    stamp(first, orig);
+    if (getline(&line, &size, in) <= 0 || strcmp(line, first) != 0) {
+        free(line);
+        return -1;
+    }
+    while ((len = getline(&line, &size, in)) > 0) {
+        if (line[len - 1] == '\n')
+            line[--len] = '\0';
+        if (line[0] == '+' && sscanf(line, "+%d%n", &pos, &start) == 1
+            && pos > 0 && line[start] == ' ') {
+            insertAt(L, pos, line + start + 1);
+            count++;
+        } else if (line[0] == '-' && sscanf(line, "-%d", &pos) == 1
+                   && pos > 0) {
+            deleteAt(L, pos);
+            count++;
+        }
+    }
+    free(line);
+    return count;
+}
@@ -0,0 +1,60 @@
+// Journal.h - Interface to undo/redo journal of edits to a DLList
+// Implementation given in Journal.c
+// Edits are made through the journal, which remembers them so that
+// they can be undone and redone, and can save them to a file (a
+// sidecar to the file the DLList came from) to be replayed later
+// The saved file starts with the size and modification time of the
+// file the DLList came from, so that it is only replayed on that
+// file, as it was when the edits were made
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include "DLList.h"
+
+typedef struct JournalRep *Journal;
+
+// create a new empty Journal
+Journal newJournal();
+
+// free up all space associated with journal
+void freeJournal(Journal);
+
+// insert an item before current item, as DLListBefore(), and
+// remember it
+void JournalBefore(Journal, DLList, char *);
+
+// insert an item after current item, as DLListAfter(), and
+// remember it
+void JournalAfter(Journal, DLList, char *);
+
+// delete current item, as DLListDelete(), and remember it
+void JournalDelete(Journal, DLList);
+
+// undo the last edit that hasn't been undone
+// a deleted item comes back as the current item; after an insert, the
+// item that was current before it is current again
+// return 0 if there is nothing to undo
+int JournalUndo(Journal, DLList);
+
+// redo the last edit undone, if nothing has been edited since
+// return 0 if there is nothing to redo
+int JournalRedo(Journal, DLList);
+
+// append the edits (and undos and redos) made since the last save to
+// a file, as one line each, after a line with the size and modification
+// time (from stat()) of the file the list came from if the file is empty
+// assume that the file is open for appending
+// return 0 if they couldn't be written
+int JournalSave(Journal, FILE *, struct stat *);
+
+// make the edits saved in a file to a list, without remembering them,
+// if they were made to the file the list came from, as its stat() is now
+// assume that the file is open for reading
+// return number of edits made, or -1 if the edits were made to some other
+// file (or the same file before it last changed)
+int JournalReplay(DLList, FILE *, struct stat *);
+
+#endif
@@ -4,9 +4,16 @@
 //
 // Documentation:
 //
-// Usage: myed FileName
+// Usage: myed [-s ScriptFile] FileName
 // Opens FileName and reads it into internal doubly-linked list
 // Gives error message if no such file or not readable
+// If FileName.journal exists, makes the edits saved in it, unless they
+// were made to some other version of FileName, in which case the next
+// save starts FileName.journal again
+// With -s, takes commands (and lines to insert) from ScriptFile rather
+// than the user, without prompting, and buffers all output until the
+// buffer fills or the script ends (it is flushed before any error
+// message, so that those still come out in the right place)
 //
 // Editor commands:
 // . = show current line
@@ -16,21 +23,29 @@
 // NN = move to line number NN
 // +NN = move forward by NN lines and show line
 // -NN = move backward by NN lines and show line
-// i = read new line and insert in front of current
-// a = read new line and insert after current
+// i = read new line (of any length) and insert in front of current
+// a = read new line (of any length) and insert after current
 // d = delete current line
+// u = undo last edit
+// r = redo last edit undone
+// s = save edits since last save, by appending them to FileName.journal
 // w = write out contents of file to file FileName.new
 // q = quit from the editor
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "DLList.h"
+#include "Journal.h"
 
 // size of line buffers
 #define MAX 100
+// size of output buffer for scripts
+#define OUT_BUF_SIZE (1 << 20)
 
-int getCommand(char *s);
+int getCommand(char *s, FILE *in, int prompt);
+int getLine(char **buf, size_t *size, FILE *in);
 void showCurrLine(DLList);
 void showHelp();
 
@@ -40,31 +55,60 @@ int main(int argc, char *argv[])
     // Variables used throughout main
 
     DLList lines;      // lines from input file as a DLList
+    Journal edits;     // edits made to lines, for undo/redo and save
     FILE *f;         // file handle
+    FILE *in;        // where commands come from
+    int  interactive; // whether commands come from the user
     char fname[MAX]; // file name
+    char jname[MAX+8]; // journal file name
+    char *jmode;     // how to open the journal file to save to it
+    struct stat st;  // size and modification time of the file
     char cmd[MAX];   // command typed by user
     int  n;          // line numbers/displacements
     int  done;       // flag for end-of-edit-session
-    char new[MAX];   // buffer to hold newly inserted line
+    char *new = NULL; // buffer to hold newly inserted line ...
+    size_t newSize = 0; // ... and its size
 
     // Check command-line args
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s FileName\n", argv[0]);
+    in = stdin;
+    interactive = 1;
+    if (argc == 4 && strcmp(argv[1],"-s") == 0) {
+        if ((in = fopen(argv[2],"r")) == NULL) {
+            fprintf(stderr, "Can't open script %s\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        interactive = 0;
+        setvbuf(stdout, NULL, _IOFBF, OUT_BUF_SIZE);
+        argv += 2;
+    } else if (argc != 2) {
+        fprintf(stderr, "Usage: %s [-s ScriptFile] FileName\n", argv[0]);
         return EXIT_FAILURE;
     }
     strcpy(fname,argv[1]);
-    if ((f = fopen(fname,"r")) == NULL) {
+    if ((f = fopen(fname,"r")) == NULL || fstat(fileno(f),&st) != 0) {
         fprintf(stderr, "Can't open file %s\n", argv[1]);
         return EXIT_FAILURE;
     }
     lines = getDLList(f);
     fclose(f);
+    edits = newJournal();
+    sprintf(jname,"%s.journal",fname);
+    jmode = "a";
+    if ((f = fopen(jname,"r")) != NULL) {
+        if ((n = JournalReplay(lines,f,&st)) < 0) {
+            printf("%s is for another version of %s; not replayed\n",
+                   jname, fname);
+            jmode = "w";
+        } else
+            printf("Made %d edits from %s\n", n, jname);
+        fclose(f);
+    }
 
     // Main loop
 
     done = 0;
-    while (!done && getCommand(cmd)) {
+    while (!done && getCommand(cmd,in,interactive)) {
         switch (cmd[0]) {
         case '.':
             // show current line
@@ -100,26 +144,50 @@ int main(int argc, char *argv[])
             break;
         case 'i':
             // read new line and insert in front of current
-            fgets(new,MAX,stdin);
-            new[strlen(new)-1] = '\0';
-            DLListBefore(lines,new);
+            if (getLine(&new,&newSize,in))
+                JournalBefore(edits,lines,new);
             break;
         case 'a':
             // read new line and insert after current
-            fgets(new,MAX,stdin);
-            new[strlen(new)-1] = '\0';
-            DLListAfter(lines,new);
+            if (getLine(&new,&newSize,in))
+                JournalAfter(edits,lines,new);
             break;
         case 'd':
             // delete current line
-            DLListDelete(lines);
+            JournalDelete(edits,lines);
+            break;
+        case 'u':
+            // undo last edit
+            if (JournalUndo(edits,lines))
+                showCurrLine(lines);
+            else
+                printf("Nothing to undo\n");
+            break;
+        case 'r':
+            // redo last edit undone
+            if (JournalRedo(edits,lines))
+                showCurrLine(lines);
+            else
+                printf("Nothing to redo\n");
+            break;
+        case 's':
+            // append edits since last save to FileName.journal
+            if ((f = fopen(jname,jmode)) == NULL || !JournalSave(edits,f,&st)) {
+                fflush(stdout);
+                fprintf(stderr, "Can't write %s\n",jname);
+            }
+            else
+                jmode = "a";
+            if (f != NULL)
+                fclose(f);
             break;
         case 'w':
             // write lines to FileName.new
             strcat(fname,".new");
-            if ((f = fopen(fname,"w")) == NULL)
+            if ((f = fopen(fname,"w")) == NULL) {
+                fflush(stdout);
                 fprintf(stderr, "Can't write %s\n",fname);
-            else {
+            } else {
                 showDLList(f,lines);
                 fclose(f);
             }
@@ -131,19 +199,46 @@ int main(int argc, char *argv[])
     }
 
     // Finish up cleanly
+    free(new);
+    freeJournal(edits);
     freeDLList(lines);
+    if (in != stdin)
+        fclose(in);
 
     return EXIT_SUCCESS;
 }
 
-// getCommand(buf)
-// prompt for and read next user command
+// getCommand(buf,in,prompt)
+// prompt for (if prompt is set) and read next command from in
 // store it in buf
 // return 1 if got a command, 0 if EOF
-int getCommand(char *buf)
+// the rest of a line too long for buf is skipped, not taken as another
+// command
+int getCommand(char *buf, FILE *in, int prompt)
+{
+    int c;
+    if (prompt)
+        printf("> ");
+    if (fgets(buf, MAX, in) == NULL)
+        return 0;
+    if (strchr(buf, '\n') == NULL)
+        while ((c = getc(in)) != '\n' && c != EOF)
+            ;
+    return 1;
+}
+
+// getLine(buf,size,in)
+// read next line from in, however long, into *buf (of *size bytes,
+// made bigger if need be), without its '\n'
+// return 1 if got a line, 0 if EOF
+int getLine(char **buf, size_t *size, FILE *in)
 {
-    printf("> ");
-    return (fgets(buf, MAX, stdin) != NULL);
+    ssize_t len = getline(buf, size, in);
+    if (len <= 0)
+        return 0;
+    if ((*buf)[len-1] == '\n')
+        (*buf)[len-1] = '\0';
+    return 1;
 }
 
 // showCurrLine(lines)
@@ -168,6 +263,9 @@ void showHelp()
     printf("i = read new line and insert in front of current\n");
     printf("a = read new line and insert after current\n");
     printf("d = delete current line\n");
+    printf("u = undo last edit\n");
+    printf("r = redo last edit undone\n");
+    printf("s = save edits since last save to FileName.journal\n");
     printf("w = write out contents of file to file FileName.new\n");
     printf("? = show this help message\n");
     printf("q = quit from the editor\n");